@@ -1051,6 +1051,88 @@ void ATimeSpace::EqReTransfer(double rai, double deci, double& rao, double& deco
 	Eclip2Eq(l, b, eps0, rao, deco);
 }
 
+void ATimeSpace::EqReTransfer(int n, const double rai[], const double deci[], double rao[], double deco[]) {
+	double t = -1 * JulianCentury();	// 输出历元与输入历元之间的儒略世纪数
+	double eps0= 84381.406 * AS2R;		// J2000对应的黄赤交角
+	double eps = MeanObliquity() + NutationObliquity();	// 输入历元对应的真黄赤交角
+	double nl = NutationLongitude();	// 黄经章动
+	double lsun = MeanLongSun() + CenterSun();	// 太阳真黄经
+	double ec = EccentricityEarth();		// 地球偏心率
+	double pl = PerihelionLongEarth();	// 地球轨道近日点黄经
+	double K = -20.49552 * AS2R;
+	double ce = cos(eps), se = sin(eps);
+	double cls = cos(lsun), sls = sin(lsun), cpl = ec * cos(pl), spl = ec * sin(pl);
+	double x, y, z, cx, sx, cy, sy, cf, sf, ce0, se0;
+	double P[3][3], R[3][3];
+	int i, j;
+
+	/* 岁差: 黄道坐标(l, b)至J2000黄道坐标的旋转矩阵, 与EqReTransfer()的(A, B, C)表达式等价 */
+	x = (47.0029 + (0.03301 + 6E-5 * t) * t) * t * AS2R;
+	y = (629554.9824 - (4159.2878 - 1.14649 * t) * t) * AS2R;
+	z = (5029.0966 - (1.11113 + 6E-6 * t) * t) * t * AS2R;
+	cx = cos(x), sx = sin(x);
+	cy = cos(y), sy = sin(y);
+	cf = cos(y + z), sf = sin(y + z);
+	// (B, A, C) = Q * (cos b cos l, cos b sin l, sin b)
+	double Q[3][3] = {
+		{ cy,       sy,       0.0 },
+		{ cx * sy, -cx * cy, -sx  },
+		{ sx * sy, -sx * cy,  cx  }
+	};
+	// J2000黄道直角坐标 = (cf * B + sf * A, sf * B - cf * A, C)
+	for (j = 0; j < 3; ++j) {
+		P[0][j] = cf * Q[0][j] + sf * Q[1][j];
+		P[1][j] = sf * Q[0][j] - cf * Q[1][j];
+		P[2][j] = Q[2][j];
+	}
+	/* J2000黄道坐标转换为赤道坐标 */
+	ce0 = cos(eps0), se0 = sin(eps0);
+	for (j = 0; j < 3; ++j) {
+		R[0][j] = P[0][j];
+		R[1][j] = ce0 * P[1][j] - se0 * P[2][j];
+		R[2][j] = se0 * P[1][j] + ce0 * P[2][j];
+	}
+
+	for (i = 0; i < n; ++i) {
+		double cra = cos(rai[i]), sra = sin(rai[i]);
+		double cdc = cos(deci[i]), sdc = sin(deci[i]);
+		double vx, vy, vz, cb0, sb0, cl0, sl0, cb, sb, cl, sl, dl, db, cd, sd, ex, ey, ez;
+
+		/* 当前历元黄道坐标 */
+		vx = cdc * cra;
+		vy = cdc * sra * ce + sdc * se;
+		vz = sdc * ce - cdc * sra * se;
+		cb0 = sqrt(vx * vx + vy * vy);
+		sb0 = vz;
+		if (cb0 > 0.0) cl0 = vx / cb0, sl0 = vy / cb0;
+		else cl0 = 1.0, sl0 = 0.0;
+
+		/* 光行差与章动, 两次迭代 */
+		cb = cb0, sb = sb0, cl = cl0, sl = sl0;
+		for (j = 0; j < 2; ++j) {
+			// cos(lsun - l) = cls * cl + sls * sl; sin(lsun - l) = sls * cl - cls * sl
+			dl = K * ((cls * cl + sls * sl) - (cpl * cl + spl * sl)) / cb;
+			db = K * sb * ((sls * cl - cls * sl) - (spl * cl - cpl * sl));
+			// l = l0 - nl - dl, b = b0 - db
+			cd = cos(nl + dl), sd = sin(nl + dl);
+			cl = cl0 * cd + sl0 * sd;
+			sl = sl0 * cd - cl0 * sd;
+			cd = cos(db), sd = sin(db);
+			cb = cb0 * cd + sb0 * sd;
+			sb = sb0 * cd - cb0 * sd;
+		}
+
+		/* 岁差及J2000黄道坐标转换为赤道坐标 */
+		vx = cb * cl, vy = cb * sl, vz = sb;
+		ex = R[0][0] * vx + R[0][1] * vy + R[0][2] * vz;
+		ey = R[1][0] * vx + R[1][1] * vy + R[1][2] * vz;
+		ez = R[2][0] * vx + R[2][1] * vy + R[2][2] * vz;
+		rao[i]  = atan2(ey, ex);
+		deco[i] = atan2(ez, sqrt(ex * ex + ey * ey));
+		if (rao[i] < 0) rao[i] += A2PI;
+	}
+}
+
 int ATimeSpace::TwilightTime(double& sunrise, double& sunset, int type) {
 	double alt;
 	alt = type == 1 ? -6.0 :			// 民用晨昏时
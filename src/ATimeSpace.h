@@ -790,6 +790,19 @@ public:
 	 * 已验证与EqTransfer()的一致性. Nov 17, 2018
 	 */
 	void EqReTransfer(double rai, double deci, double& rao, double& deco);
+	/*!
+	 * @brief 批量赤道坐标历元转换. 输入坐标系: UTC对应历元, 输出坐标系: J2000
+	 * @param n     坐标数量
+	 * @param rai   输入赤经, 量纲: 弧度
+	 * @param deci  输入赤纬, 量纲: 弧度
+	 * @param rao   输出赤经, 量纲: 弧度. 可与rai为同一数组
+	 * @param deco  输出赤纬, 量纲: 弧度. 可与deci为同一数组
+	 * @note
+	 * - 与历元相关的黄赤交角、章动、太阳黄经、岁差等只计算一次, 岁差与黄道至赤道转换
+	 *   合并为一个旋转矩阵, 逐点只计算光行差迭代与矩阵乘法
+	 * - 与EqReTransfer()逐点转换结果的偏差小于0.1毫角秒
+	 */
+	void EqReTransfer(int n, const double rai[], const double deci[], double rao[], double deco[]);
 	/*!
 	 * @brief 计算晨光始与昏影终
 	 * @param sunrise 晨光始, 量纲: 小时
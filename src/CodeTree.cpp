@@ -0,0 +1,441 @@
+/**
+ * @file CodeTree.cpp 星形哈希码的kd树及其文件
+ */
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include "ImplicitTree.hpp"
+#include "ShapeEngine.h"
+#include "ZoneIndex.h"
+#include "CodeTree.h"
+
+using namespace std;
+
+/*!
+ * @struct CodeTreeHeader 文件头
+ */
+struct CodeTreeHeader {
+	char magic[8];		//< 文件标志
+	uint32_t version;	//< 格式版本
+	int32_t dim;		//< 哈希码维数
+	int32_t nstar;		//< 每个星形的星数
+	int32_t depth;		//< 叶节点所在的层数
+	uint32_t format;	//< 哈希码与包围盒的存储格式
+	uint32_t tagged;	//< 是否存储星形的标记
+	uint64_t count;		//< 星形数
+	uint64_t nlist;		//< 星序号所指向星表的星数
+	uint64_t checksum;	//< 星序号所指向星表的校验和, 见StarTable::Checksum()
+	uint64_t offset[4];	//< 节点包围盒、哈希码、星序号与标记在文件中的起始位置
+	double base[CODE_TREE_MAXDIM];	//< 量化: 各维的最小值
+	double step[CODE_TREE_MAXDIM];	//< 量化: 各维的步长
+};
+
+#define CODE_TREE_MAGIC		"TYC2CKD"
+#define CODE_TREE_VERSION	4
+#define CODE_TREE_ALIGN		64
+#define CODE_TREE_QMAX		65535	//< 定点数上限
+
+CodeTree::CodeTree() {
+	dim_ = nstar_ = depth_ = 0;
+	count_ = nlist_ = checksum_ = 0;
+	format_ = CODE_DOUBLE;
+	box_  = code_ = NULL;
+	fbox_ = fcode_ = NULL;
+	qbox_ = qcode_ = NULL;
+	star_ = NULL;
+	tag_  = NULL;
+}
+
+CodeTree::~CodeTree() {
+}
+
+void CodeTree::split_node(const double *code, uint32_t *order, size_t lo, size_t hi) const {
+	const size_t nsample(1024);	// 估计分布范围的抽样星形数
+	size_t i, n(hi - lo), step = n > nsample ? n / nsample : 1, mid = lo + n / 2;
+	double vmin[CODE_TREE_MAXDIM], vmax[CODE_TREE_MAXDIM];
+	int d, dim(dim_), best(0);
+
+	for (d = 0; d < dim; ++d) {
+		vmin[d] = HUGE_VAL;
+		vmax[d] = -HUGE_VAL;
+	}
+	for (i = lo; i < hi; i += step) {
+		const double *c = code + size_t(order[i]) * dim;
+		for (d = 0; d < dim; ++d) {
+			if (c[d] < vmin[d]) vmin[d] = c[d];
+			if (c[d] > vmax[d]) vmax[d] = c[d];
+		}
+	}
+	for (d = 1; d < dim; ++d) {
+		if (vmax[d] - vmin[d] > vmax[best] - vmin[best]) best = d;
+	}
+	nth_element(order + lo, order + mid, order + hi, [code, dim, best](uint32_t a, uint32_t b) {
+		return code[size_t(a) * dim + best] < code[size_t(b) * dim + best];
+	});
+}
+
+void CodeTree::merge_children(int node) {
+	double *box = &boxbuf_[size_t(node) * 2 * dim_];
+	const double *l = &boxbuf_[size_t(2 * node + 1) * 2 * dim_];
+	const double *r = &boxbuf_[size_t(2 * node + 2) * 2 * dim_];
+
+	for (int d = 0; d < dim_; ++d) {
+		box[d] = min(l[d], r[d]);
+		box[dim_ + d] = max(l[dim_ + d], r[dim_ + d]);
+	}
+}
+
+void CodeTree::bound_leaf(int node, size_t lo, size_t hi) {
+	double *box = &boxbuf_[size_t(node) * 2 * dim_];
+	int d;
+
+	for (d = 0; d < dim_; ++d) {
+		box[d] = HUGE_VAL;
+		box[dim_ + d] = -HUGE_VAL;
+	}
+	for (size_t i = lo; i < hi; ++i) {
+		const double *c = &codebuf_[i * dim_];
+		for (d = 0; d < dim_; ++d) {
+			if (c[d] < box[d]) box[d] = c[d];
+			if (c[d] > box[dim_ + d]) box[dim_ + d] = c[d];
+		}
+	}
+}
+
+double CodeTree::QuantizeError() const {
+	double e(0.0);
+	if (format_ == CODE_FIXED16) {
+		for (int d = 0; d < dim_; ++d) {
+			if (step_[d] > e) e = step_[d];
+		}
+	}
+	return 0.5 * e;
+}
+
+void CodeTree::Code(size_t i, double *code) const {
+	if (format_ == CODE_FIXED16) {
+		const uint16_t *q = qcode_ + i * dim_;
+		for (int d = 0; d < dim_; ++d) code[d] = base_[d] + q[d] * step_[d];
+	}
+	else if (format_ == CODE_FLOAT) copy(fcode_ + i * dim_, fcode_ + (i + 1) * dim_, code);
+	else copy(code_ + i * dim_, code_ + (i + 1) * dim_, code);
+}
+
+void CodeTree::quantize() {
+	size_t i, nnode = (size_t(2) << depth_) - 1;
+	const double *root = &boxbuf_[0];
+	int d;
+
+	// 各维范围即根节点的包围盒. 范围为0时按单位区间取步长
+	for (d = 0; d < dim_; ++d) {
+		double range = count_ ? root[dim_ + d] - root[d] : 0.0;
+		base_[d] = count_ ? root[d] : 0.0;
+		step_[d] = (range > 0.0 ? range : 1.0) / CODE_TREE_QMAX;
+	}
+	auto fixed = [this](int d, double v) {
+		double q = quantize_value(d, v);
+		return uint16_t(q < 0.0 ? 0 : (q > CODE_TREE_QMAX ? CODE_TREE_QMAX : q));
+	};
+	qcodebuf_.resize(count_ * dim_);
+	for (i = 0; i < count_ * dim_; ++i) qcodebuf_[i] = fixed(int(i % dim_), codebuf_[i]);
+	// 空节点的包围盒下限大于上限, 量化后仍使之与任何范围不相交
+	qboxbuf_.resize(nnode * 2 * dim_);
+	for (i = 0; i < nnode; ++i) {
+		const double *box = &boxbuf_[i * 2 * dim_];
+		uint16_t *qbox = &qboxbuf_[i * 2 * dim_];
+		for (d = 0; d < dim_; ++d) {
+			if (box[d] > box[dim_ + d]) {
+				qbox[d] = CODE_TREE_QMAX;
+				qbox[dim_ + d] = 0;
+			}
+			else {
+				qbox[d] = fixed(d, box[d]);
+				qbox[dim_ + d] = fixed(d, box[dim_ + d]);
+			}
+		}
+	}
+	vector<double>().swap(boxbuf_);
+	vector<double>().swap(codebuf_);
+}
+
+void CodeTree::narrow() {
+	// 舍入单调, 单精度包围盒即为节点内单精度哈希码的包围盒. 空节点的无穷大边界不变
+	fcodebuf_.assign(codebuf_.begin(), codebuf_.end());
+	fboxbuf_.assign(boxbuf_.begin(), boxbuf_.end());
+	vector<double>().swap(boxbuf_);
+	vector<double>().swap(codebuf_);
+}
+
+void CodeTree::Build(const double *code, const uint32_t *star, const uint8_t *tag, size_t n, int dim, int nstar,
+		int nthread, int leafsize, int format) {
+	size_t i;
+
+	mf_.Unmap();
+	fboxbuf_.clear();
+	fcodebuf_.clear();
+	qboxbuf_.clear();
+	qcodebuf_.clear();
+	format_ = CODE_DOUBLE;
+	dim_   = dim;
+	nstar_ = nstar;
+	count_ = n;
+	depth_ = implicit_depth(n, leafsize);
+	boxbuf_.resize(((size_t(2) << depth_) - 1) * 2 * dim);
+	codebuf_.resize(n * dim);
+	starbuf_.resize(n * nstar);
+	tagbuf_.resize(tag ? n : 0);
+
+	vector<uint32_t> order(n);
+	for (i = 0; i < n; ++i) order[i] = uint32_t(i);
+	build_implicit_tree(n, depth_, nthread,
+		[this, code, &order](size_t lo, size_t hi) {
+			split_node(code, order.data(), lo, hi);
+		},
+		[this, code, star, tag, &order](size_t lo, size_t hi) {// 按树序取出哈希码、星序号与标记
+			for (size_t j = lo; j < hi; ++j) {
+				size_t k = order[j];
+				copy(code + k * dim_, code + (k + 1) * dim_, &codebuf_[j * dim_]);
+				copy(star + k * nstar_, star + (k + 1) * nstar_, &starbuf_[j * nstar_]);
+				if (tag) tagbuf_[j] = tag[k];
+			}
+		},
+		[this](int node, size_t lo, size_t hi) { bound_leaf(node, lo, hi); },
+		[this](int node) { merge_children(node); });
+
+	if (format == CODE_FIXED16) quantize();
+	else if (format == CODE_FLOAT) narrow();
+	else format = CODE_DOUBLE;
+	format_ = format;
+	const void *box[]  = { boxbuf_.data(), qboxbuf_.data(), fboxbuf_.data() };	// 按存储格式的序号排列
+	const void *data[] = { codebuf_.data(), qcodebuf_.data(), fcodebuf_.data() };
+	set_sections(box[format_], data[format_], starbuf_.data(), tag ? tagbuf_.data() : NULL);
+}
+
+void CodeTree::set_sections(const void *box, const void *code, const uint32_t *star, const uint8_t *tag) {
+	box_  = code_ = NULL;
+	fbox_ = fcode_ = NULL;
+	qbox_ = qcode_ = NULL;
+	if (format_ == CODE_FIXED16) {
+		qbox_  = (const uint16_t*) box;
+		qcode_ = (const uint16_t*) code;
+	}
+	else if (format_ == CODE_FLOAT) {
+		fbox_  = (const float*) box;
+		fcode_ = (const float*) code;
+	}
+	else {
+		box_  = (const double*) box;
+		code_ = (const double*) code;
+	}
+	star_ = star;
+	tag_  = tag;
+}
+
+/*!
+ * @brief 写入一段数据, 并在其后补零至对齐位置
+ */
+static bool write_aligned(FILE *fp, const void *data, size_t size, uint64_t &offset) {
+	static const char zeros[CODE_TREE_ALIGN] = { 0 };
+	size_t npad = (CODE_TREE_ALIGN - (offset + size) % CODE_TREE_ALIGN) % CODE_TREE_ALIGN;
+	if (size && fwrite(data, 1, size, fp) != size) return false;
+	if (npad && fwrite(zeros, 1, npad, fp) != npad) return false;
+	offset += size + npad;
+	return true;
+}
+
+/*!
+ * @brief 文件各段的长度, 量纲: 字节
+ */
+static void section_sizes(uint64_t count, int dim, int nstar, int depth, int format, bool tagged,
+		uint64_t sizes[4]) {
+	size_t bytes = format == CODE_FIXED16 ? sizeof(uint16_t) : (format == CODE_FLOAT ? sizeof(float) : sizeof(double));
+	sizes[0] = ((uint64_t(2) << depth) - 1) * 2 * dim * bytes;
+	sizes[1] = count * dim * bytes;
+	sizes[2] = count * nstar * sizeof(uint32_t);
+	sizes[3] = tagged ? count * sizeof(uint8_t) : 0;
+}
+
+bool CodeTree::Save(const char *filepath) const {
+	char tmppath[260];
+	CodeTreeHeader header;
+	uint64_t sizes[4], offset;
+	int i;
+
+	memset(&header, 0, sizeof(CodeTreeHeader));
+	memcpy(header.magic, CODE_TREE_MAGIC, sizeof(CODE_TREE_MAGIC));
+	header.version = CODE_TREE_VERSION;
+	header.dim     = dim_;
+	header.nstar   = nstar_;
+	header.depth   = depth_;
+	header.format  = format_;
+	header.tagged  = tag_ != NULL;
+	header.count   = count_;
+	header.nlist   = nlist_;
+	header.checksum = checksum_;
+	if (format_ == CODE_FIXED16) {
+		memcpy(header.base, base_, sizeof(double) * dim_);
+		memcpy(header.step, step_, sizeof(double) * dim_);
+	}
+	section_sizes(count_, dim_, nstar_, depth_, format_, tag_ != NULL, sizes);
+	offset = (sizeof(CodeTreeHeader) + CODE_TREE_ALIGN - 1) / CODE_TREE_ALIGN * CODE_TREE_ALIGN;
+	for (i = 0; i < 4; ++i) {
+		header.offset[i] = offset;
+		offset += (sizes[i] + CODE_TREE_ALIGN - 1) / CODE_TREE_ALIGN * CODE_TREE_ALIGN;
+	}
+	const void *box[]  = { box_, qbox_, fbox_ };
+	const void *code[] = { code_, qcode_, fcode_ };
+	const void *data[4] = { box[format_], code[format_], star_, tag_ };
+
+	FILE *fp;
+	sprintf (tmppath, "%s.tmp", filepath);
+	if ((fp = fopen(tmppath, "wb")) == NULL) {
+		printf ("failed to create %s\n", tmppath);
+		return false;
+	}
+	offset = 0;
+	bool rslt = write_aligned(fp, &header, sizeof(CodeTreeHeader), offset);
+	for (i = 0; i < 4 && rslt; ++i) rslt = write_aligned(fp, data[i], sizes[i], offset);
+	rslt = !fclose(fp) && rslt && !rename(tmppath, filepath);
+	if (!rslt) {
+		printf ("failed to write %s\n", filepath);
+		remove(tmppath);
+	}
+	return rslt;
+}
+
+bool CodeTree::Load(const char *filepath, const ZoneIndex *stars) {
+	mf_.Unmap();
+	boxbuf_.clear();
+	codebuf_.clear();
+	fboxbuf_.clear();
+	fcodebuf_.clear();
+	qboxbuf_.clear();
+	qcodebuf_.clear();
+	starbuf_.clear();
+	tagbuf_.clear();
+	count_ = nlist_ = checksum_ = 0;
+	format_ = CODE_DOUBLE;
+	set_sections(NULL, NULL, NULL, NULL);
+	if (!mf_.Map(filepath, false) || mf_.size < sizeof(CodeTreeHeader)) return false;
+
+	const CodeTreeHeader *hdr = (const CodeTreeHeader*) mf_.data;
+	uint64_t sizes[4];
+	bool valid = !memcmp(hdr->magic, CODE_TREE_MAGIC, sizeof(CODE_TREE_MAGIC)) && hdr->version == CODE_TREE_VERSION
+			&& hdr->dim > 0 && hdr->dim <= CODE_TREE_MAXDIM && hdr->nstar > 0 && hdr->nstar <= SHAPE_MAX_STAR
+			&& hdr->depth >= 0 && hdr->depth < 48 && hdr->format <= CODE_FLOAT && hdr->tagged <= 1
+			&& hdr->count <= mf_.size;
+	for (int d = 0; valid && hdr->format == CODE_FIXED16 && d < hdr->dim; ++d) valid = hdr->step[d] > 0.0;
+	if (valid) {// 星形数不超过文件长度, 各段长度不溢出
+		section_sizes(hdr->count, hdr->dim, hdr->nstar, hdr->depth, hdr->format, hdr->tagged, sizes);
+		for (int i = 0; i < 4 && valid; ++i) {
+			valid = hdr->offset[i] % CODE_TREE_ALIGN == 0 && hdr->offset[i] <= mf_.size
+					&& sizes[i] <= mf_.size - hdr->offset[i];
+		}
+	}
+	if (!valid) {
+		printf ("%s is not a valid code tree file\n", filepath);
+		mf_.Unmap();
+		return false;
+	}
+	if (stars && (hdr->nlist != stars->Size() || hdr->checksum != stars->Checksum())) {
+		printf ("%s does not match its star list\n", filepath);
+		mf_.Unmap();
+		return false;
+	}
+
+	dim_   = hdr->dim;
+	nstar_ = hdr->nstar;
+	depth_ = hdr->depth;
+	count_ = hdr->count;
+	nlist_ = hdr->nlist;
+	checksum_ = hdr->checksum;
+	format_ = hdr->format;
+	if (format_ == CODE_FIXED16) {
+		memcpy(base_, hdr->base, sizeof(double) * dim_);
+		memcpy(step_, hdr->step, sizeof(double) * dim_);
+	}
+	set_sections(mf_.data + hdr->offset[0], mf_.data + hdr->offset[1], (const uint32_t*) (mf_.data + hdr->offset[2]),
+			hdr->tagged ? (const uint8_t*) (mf_.data + hdr->offset[3]) : NULL);
+	return true;
+}
+
+template <class T, class R, class Match>
+int CodeTree::search_tree(const T *box, const R *lo, const R *hi, int tag, const Match &match,
+		vector<uint32_t> &result, size_t *nvisit) const {
+	const uint8_t *tags = tag >= 0 ? tag_ : NULL;
+	size_t nnode = walk_implicit_tree(count_, depth_, [&](const TreeRange &r) -> int {
+		const T *b = box + size_t(r.node) * 2 * dim_;
+		bool inside(true);
+		int d;
+
+		for (d = 0; d < dim_; ++d) {
+			if (b[d] > hi[d] || b[dim_ + d] < lo[d]) return TREE_SKIP;
+			inside &= b[d] >= lo[d] && b[dim_ + d] <= hi[d];
+		}
+		if (inside) {// 节点完全位于检索范围内
+			for (size_t i = r.lo; i < r.hi; ++i) {
+				if (!tags || tags[i] == tag) result.push_back(uint32_t(i));
+			}
+			return TREE_SKIP;
+		}
+		if (r.level == depth_) {
+			for (size_t i = r.lo; i < r.hi; ++i) {
+				if ((!tags || tags[i] == tag) && match(i)) result.push_back(uint32_t(i));
+			}
+			return TREE_SKIP;
+		}
+		return TREE_LEFT_FIRST;
+	});
+	if (nvisit) *nvisit = nnode;
+	return int(result.size());
+}
+
+int CodeTree::Search(const double *code, double tol, vector<uint32_t> &result, size_t *nvisit, int tag) const {
+	int d;
+
+	result.clear();
+	if (nvisit) *nvisit = 0;
+	if (!count_) return 0;
+
+	if (format_ != CODE_FIXED16) {
+		double qlo[CODE_TREE_MAXDIM], qhi[CODE_TREE_MAXDIM];
+		for (d = 0; d < dim_; ++d) {
+			qlo[d] = code[d] - tol;
+			qhi[d] = code[d] + tol;
+		}
+		if (format_ == CODE_DOUBLE) {
+			return search_tree(box_, qlo, qhi, tag, [this, code, tol](size_t i) {
+				return ShapeEngine::CodeWithin(code, code_ + i * dim_, dim_, tol);
+			}, result, nvisit);
+		}
+		// 单精度数值与检索范围以双精度比较, 与双精度存储的判定规则相同
+		return search_tree(fbox_, qlo, qhi, tag, [this, code, tol](size_t i) {
+			const float *c = fcode_ + i * dim_;
+			for (int j = 0; j < dim_; ++j) {
+				if (fabs(c[j] - code[j]) > tol) return false;
+			}
+			return true;
+		}, result, nvisit);
+	}
+
+	/* 容差范围的端点按量化规则舍入: 舍入单调, 容差内数值的定点数必在区间内.
+	 * 端点另外放宽1E-6步, 避免浮点误差导致的边界遗漏 */
+	uint16_t qlo[CODE_TREE_MAXDIM], qhi[CODE_TREE_MAXDIM];
+	for (d = 0; d < dim_; ++d) {
+		double lo = quantize_value(d, code[d] - tol - 1E-6 * step_[d]);
+		double hi = quantize_value(d, code[d] + tol + 1E-6 * step_[d]);
+		if (lo > CODE_TREE_QMAX || hi < 0.0) return 0;
+		qlo[d] = uint16_t(lo < 0.0 ? 0 : lo);
+		qhi[d] = uint16_t(hi > CODE_TREE_QMAX ? CODE_TREE_QMAX : hi);
+	}
+	const uint16_t *qcode = qcode_;
+	int dim = dim_;
+	return search_tree(qbox_, qlo, qhi, tag, [qcode, dim, &qlo, &qhi](size_t i) {
+		const uint16_t *q = qcode + i * dim;
+		for (int j = 0; j < dim; ++j) {
+			if (q[j] < qlo[j] || q[j] > qhi[j]) return false;
+		}
+		return true;
+	}, result, nvisit);
+}
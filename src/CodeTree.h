@@ -0,0 +1,232 @@
+/**
+ * @file CodeTree.h 星形哈希码的kd树及其文件
+ * @note
+ * - 隐式布局同KdTree(见ImplicitTree.hpp): 节点按层序存储于数组, 节点i的子节点为2i+1与2i+2, 节点的哈希码
+ *   范围由其序号逐层对半划分得到. 节点只存储各维的包围盒, 哈希码与星序号按树序另行连续存储
+ * - 文件结构: 文件头、节点包围盒、哈希码、星序号、标记. 各段起始位置按64字节对齐.
+ *   加载时内存映射文件, 各段直接作为数组检索, 不解析、不复制
+ * - 文件头记录星序号所指向星表的星数与校验和, 加载时与星表核对, 拒绝不配套的文件
+ * - 容差检索访问的节点数为O(log(n))加上与检索范围相交的叶节点数
+ * - 量化存储: 哈希码与包围盒按维以16位定点数存储, 各维由最小值起以(最大值-最小值)/65535为步长.
+ *   检索范围按相同的舍入规则换算为定点数区间, 量化误差计入容差, 不遗漏容差内的星形.
+ *   星序号仍为32位. 哈希码与包围盒缩小至1/4
+ * - 单精度存储: 哈希码与包围盒以float存储, 检索判定与双精度存储相同. 用于本身为单精度的三角形哈希码
+ * - 标记: 可选每个星形1字节, 如三角形的奇偶性. 检索时只返回标记相同的星形, 标记不参与划分
+ */
+
+#ifndef CODETREE_H_
+#define CODETREE_H_
+
+#include <stdint.h>
+#include <math.h>
+#include <vector>
+#include "MappedFile.hpp"
+
+class ZoneIndex;
+
+#define CODE_TREE_LEAFSIZE	8	//< 叶节点的最多星形数
+#define CODE_TREE_MAXDIM	20	//< 哈希码维数上限: 10颗星
+
+enum {// 哈希码与包围盒的存储格式
+	CODE_DOUBLE,	//< 双精度
+	CODE_FIXED16,	//< 16位定点数
+	CODE_FLOAT		//< 单精度
+};
+
+class CodeTree {
+public:
+	CodeTree();
+	virtual ~CodeTree();
+
+protected:
+	MappedFile mf_;		//< 内存映射的文件
+	int dim_;			//< 哈希码维数
+	int nstar_;			//< 每个星形的星数
+	int depth_;			//< 叶节点所在的层数. 根节点为第0层
+	uint64_t count_;	//< 星形数
+	uint64_t nlist_;	//< 星序号所指向星表的星数
+	uint64_t checksum_;	//< 星序号所指向星表的校验和
+	int format_;		//< 哈希码与包围盒的存储格式
+	double base_[CODE_TREE_MAXDIM];	//< 量化: 各维的最小值
+	double step_[CODE_TREE_MAXDIM];	//< 量化: 各维的步长
+	const double *box_;		//< 节点包围盒: 每个节点dim个下限与dim个上限
+	const double *code_;	//< 按树序存储的哈希码
+	const float *fbox_;		//< 单精度的节点包围盒
+	const float *fcode_;	//< 单精度的哈希码
+	const uint16_t *qbox_;	//< 量化的节点包围盒
+	const uint16_t *qcode_;	//< 量化的哈希码
+	const uint32_t *star_;	//< 按树序存储的星序号
+	const uint8_t *tag_;	//< 按树序存储的标记. NULL: 无标记
+	/* 构建结果. 加载文件时不使用 */
+	std::vector<double> boxbuf_, codebuf_;
+	std::vector<float> fboxbuf_, fcodebuf_;
+	std::vector<uint16_t> qboxbuf_, qcodebuf_;
+	std::vector<uint32_t> starbuf_;
+	std::vector<uint8_t> tagbuf_;
+
+public:
+	/*!
+	 * @brief 构建kd树
+	 * @param code      哈希码, 每个星形dim个
+	 * @param star      星序号, 每个星形nstar个
+	 * @param tag       标记, 每个星形1个. NULL: 无标记
+	 * @param n         星形数
+	 * @param dim       哈希码维数
+	 * @param nstar     每个星形的星数
+	 * @param nthread   线程数. 0: 使用全部硬件线程
+	 * @param leafsize  叶节点的最多星形数
+	 * @param format    哈希码与包围盒的存储格式
+	 * @note
+	 * - 每个节点沿分布范围最大(抽样估计)的维以中位数对半划分
+	 * - 上层节点逐层并行划分, 之后各线程独立划分一棵子树、按树序取出数据并计算包围盒
+	 * - 树结构与存储格式无关. 舍入单调, 量化或单精度的包围盒即为节点内哈希码存储值的包围盒
+	 */
+	void Build(const double *code, const uint32_t *star, const uint8_t *tag, size_t n, int dim, int nstar,
+			int nthread = 0, int leafsize = CODE_TREE_LEAFSIZE, int format = CODE_DOUBLE);
+	/*!
+	 * @brief 记录星序号所指向的星表, 随文件存储
+	 * @param count     星表的星数
+	 * @param checksum  星表的校验和, 见StarTable::Checksum()
+	 */
+	void SetStarList(uint64_t count, uint64_t checksum) {
+		nlist_    = count;
+		checksum_ = checksum;
+	}
+	/*!
+	 * @brief 存储为文件
+	 * @param filepath  文件路径
+	 * @return
+	 * 存储结果
+	 */
+	bool Save(const char *filepath) const;
+	/*!
+	 * @brief 内存映射文件
+	 * @param filepath  文件路径
+	 * @param stars     星序号所指向的星表. NULL: 不检查
+	 * @return
+	 * 文件是否有效, 且与星表的星数及校验和一致
+	 */
+	bool Load(const char *filepath, const ZoneIndex *stars = NULL);
+	/*!
+	 * @brief 星形数
+	 */
+	size_t Size() const {
+		return count_;
+	}
+	/*!
+	 * @brief 哈希码维数
+	 */
+	int Dim() const {
+		return dim_;
+	}
+	/*!
+	 * @brief 每个星形的星数
+	 */
+	int StarCount() const {
+		return nstar_;
+	}
+	/*!
+	 * @brief 叶节点所在的层数
+	 */
+	int Depth() const {
+		return depth_;
+	}
+	/*!
+	 * @brief 哈希码与包围盒的存储格式
+	 */
+	int Format() const {
+		return format_;
+	}
+	/*!
+	 * @brief 哈希码是否量化存储
+	 */
+	bool Quantized() const {
+		return format_ == CODE_FIXED16;
+	}
+	/*!
+	 * @brief 是否存储星形的标记
+	 */
+	bool Tagged() const {
+		return tag_ != NULL;
+	}
+	/*!
+	 * @brief 量化误差上限, 即各维步长的一半. 不量化时为0
+	 */
+	double QuantizeError() const;
+	/*!
+	 * @brief 按树序取一个星形的哈希码. 量化存储时为还原值
+	 */
+	void Code(size_t i, double *code) const;
+	/*!
+	 * @brief 按树序取一个星形的星序号
+	 */
+	const uint32_t *Stars(size_t i) const {
+		return star_ + i * nstar_;
+	}
+	/*!
+	 * @brief 按树序取一个星形的标记. 无标记时为0
+	 */
+	int Tag(size_t i) const {
+		return tag_ ? tag_[i] : 0;
+	}
+	/*!
+	 * @brief 容差检索
+	 * @param code    检索哈希码, dim维
+	 * @param tol     各维的容差
+	 * @param result  检索结果: 各维之差均不超过tol的星形, 按树序排列
+	 * @param nvisit  访问的节点数. NULL: 不统计
+	 * @param tag     标记. 负数: 不限制; 其它: 只返回标记相同的星形
+	 * @return
+	 * 检索到的星形数
+	 * @note
+	 * - 包围盒与检索范围不相交时剪枝, 完全位于范围内的节点整体加入结果
+	 * - 量化存储时以定点数比较: 结果包含容差内的全部星形, 及超出容差不多于QuantizeError()的星形
+	 */
+	int Search(const double *code, double tol, std::vector<uint32_t> &result, size_t *nvisit = NULL,
+			int tag = -1) const;
+
+protected:
+	/*!
+	 * @brief 以中位数对半划分一段星形
+	 */
+	void split_node(const double *code, uint32_t *order, size_t lo, size_t hi) const;
+	/*!
+	 * @brief 计算叶节点的包围盒
+	 */
+	void bound_leaf(int node, size_t lo, size_t hi);
+	/*!
+	 * @brief 由子节点合并包围盒
+	 */
+	void merge_children(int node);
+	/*!
+	 * @brief 以16位定点数存储已构建的哈希码与包围盒, 并释放其双精度数据
+	 */
+	void quantize();
+	/*!
+	 * @brief 以单精度存储已构建的哈希码与包围盒, 并释放其双精度数据
+	 */
+	void narrow();
+	/*!
+	 * @brief 按存储格式设置各段的数组
+	 */
+	void set_sections(const void *box, const void *code, const uint32_t *star, const uint8_t *tag);
+	/*!
+	 * @brief 一维数值的定点数: 由最小值起的步数, 四舍五入. 未限制于0~65535
+	 */
+	double quantize_value(int d, double v) const {
+		return floor((v - base_[d]) / step_[d] + 0.5);
+	}
+	/*!
+	 * @brief 遍历kd树
+	 * @param box    节点包围盒
+	 * @param lo     检索范围下限
+	 * @param hi     检索范围上限
+	 * @param tag    标记. 负数: 不限制
+	 * @param match  叶节点中的星形是否位于检索范围内
+	 */
+	template <class T, class R, class Match>
+	int search_tree(const T *box, const R *lo, const R *hi, int tag, const Match &match,
+			std::vector<uint32_t> &result, size_t *nvisit) const;
+};
+
+#endif /* CODETREE_H_ */
@@ -0,0 +1,167 @@
+/**
+ * @file FixedShapeEngine.hpp 以星数为模板参数特化的星形生成与哈希码比较
+ * @note
+ * - 星数N在编译期确定: 哈希码、星序号与组合下标均为定长数组, 循环次数为常量,
+ *   编译器可完全展开并向量化
+ * - 计算顺序与ShapeEngine的通用实现相同, 生成结果逐位一致
+ * - N=4~10由main()按-N选择实例. N=3使用TriangleEngine, 其实例只用于性能对比
+ */
+
+#ifndef FIXED_SHAPE_ENGINE_HPP_
+#define FIXED_SHAPE_ENGINE_HPP_
+
+#include <math.h>
+#include <algorithm>
+#include "ShapeEngine.h"
+
+/*!
+ * @struct ShapeKernel N颗星的哈希码计算与比较
+ */
+template <int N>
+struct ShapeKernel {
+	enum {
+		K   = N - 2,		//< 主干以外的星数
+		DIM = 2 * (N - 2)	//< 哈希码维数
+	};
+
+	/*!
+	 * @brief 计算星形的哈希码. 参数与约束同ShapeEngine::MakeCode()
+	 */
+	static void MakeCode(const StarTable &stars, uint32_t *star, double *code) {
+		double a[3], b[3], m[3], e1[3], e2[3];
+		double sumx(0.0);
+		int i, j;
+
+		load(stars, star[0], a);
+		load(stars, star[1], b);
+		for (i = 0; i < 3; ++i) {
+			m[i]  = a[i] + b[i];
+			e1[i] = b[i] - a[i];
+		}
+		normalize(m);
+		normalize(e1);
+		e2[0] = m[1] * e1[2] - m[2] * e1[1];
+		e2[1] = m[2] * e1[0] - m[0] * e1[2];
+		e2[2] = m[0] * e1[1] - m[1] * e1[0];
+
+		double t = dot(b, e1) / dot(b, m);
+		double scale = 0.5 / t;
+		for (i = 0; i < K; ++i) {
+			double s[3];
+			load(stars, star[i + 2], s);
+			double w  = 1.0 / dot(s, m);
+			double px = dot(s, e1) * w + t;
+			double py = dot(s, e2) * w;
+			code[2 * i]     = (px - py) * scale;
+			code[2 * i + 1] = (px + py) * scale;
+			sumx += code[2 * i];
+		}
+
+		if (sumx > 0.5 * K) {
+			std::swap(star[0], star[1]);
+			for (i = 0; i < DIM; ++i) code[i] = 1.0 - code[i];
+		}
+		for (i = 1; i < K; ++i) {
+			for (j = i; j > 0 && code[2 * j] < code[2 * j - 2]; --j) {
+				std::swap(code[2 * j], code[2 * j - 2]);
+				std::swap(code[2 * j + 1], code[2 * j - 1]);
+				std::swap(star[j + 2], star[j + 1]);
+			}
+		}
+	}
+
+	/*!
+	 * @brief 判定两个哈希码的各维之差是否均不超过容差
+	 * @note
+	 * - 每颗星的两维合并判定, 不符时提前退出
+	 */
+	static bool Within(const double *code1, const double *code2, double tol) {
+		for (int j = 0; j < DIM; j += 2) {
+			if ((fabs(code1[j] - code2[j]) > tol) | (fabs(code1[j + 1] - code2[j + 1]) > tol)) return false;
+		}
+		return true;
+	}
+
+	static double dot(const double *p, const double *q) {
+		return p[0] * q[0] + p[1] * q[1] + p[2] * q[2];
+	}
+
+	static void normalize(double *v) {
+		double s = 1.0 / sqrt(dot(v, v));
+		v[0] *= s;
+		v[1] *= s;
+		v[2] *= s;
+	}
+
+	static void load(const StarTable &stars, uint32_t i, double *v) {
+		v[0] = stars.x[i];
+		v[1] = stars.y[i];
+		v[2] = stars.z[i];
+	}
+};
+
+/*!
+ * @class FixedShapeEngine 星数为N的星形生成
+ */
+template <int N>
+class FixedShapeEngine : public ShapeEngine {
+public:
+	typedef ShapeKernel<N> Kernel;
+
+public:
+	FixedShapeEngine() : ShapeEngine(N) {}
+	virtual ~FixedShapeEngine() {}
+
+protected:
+	/*!
+	 * @brief 生成以一颗星为参考星的星形. 选择规则同ShapeEngine::shapes_of()
+	 * @note
+	 * - 候选星存储于定长数组, 不使用cand
+	 */
+	virtual void shapes_of(const StarTable &stars, const KdTree &tree, uint32_t ref, double rmax, double cosmin,
+			std::vector<uint32_t> &nb, std::vector<uint32_t> &, ShapeSet &out) const {
+		const int K = Kernel::K;
+		double a[3], b[3], m[3], s[3];
+		uint32_t shape[N], cand[SHAPE_NEIGHBOUR];
+		int c[K > 0 ? K : 1], i, j, ncand, nshape(0);
+		size_t nnb;
+
+		if ((nnb = Neighbours(stars, tree, ref, rmax, nb)) < size_t(N - 1)) return;
+		Kernel::load(stars, ref, a);
+
+		for (size_t ib = 0; ib < nnb && nshape < SHAPE_PER_STAR; ++ib) {
+			Kernel::load(stars, nb[ib], b);
+			if (Kernel::dot(a, b) > cosmin) continue;
+			for (i = 0; i < 3; ++i) m[i] = a[i] + b[i];
+			Kernel::normalize(m);
+			double cosh2 = Kernel::dot(a, m);
+
+			ncand = 0;
+			for (size_t ic = 0; ic < nnb; ++ic) {
+				if (ic == ib) continue;
+				Kernel::load(stars, nb[ic], s);
+				if (Kernel::dot(s, m) > cosh2) cand[ncand++] = nb[ic];
+			}
+			if (ncand < K) continue;
+
+			for (i = 0; i < K; ++i) c[i] = i;
+			for (int n = 0; n < SHAPE_PER_BACKBONE && nshape < SHAPE_PER_STAR; ++n) {
+				shape[0] = ref;
+				shape[1] = nb[ib];
+				for (i = 0; i < K; ++i) shape[i + 2] = cand[c[i]];
+				size_t n0 = out.code.size();
+				out.code.resize(n0 + Kernel::DIM);
+				Kernel::MakeCode(stars, shape, &out.code[n0]);
+				out.star.insert(out.star.end(), shape, shape + N);
+				++nshape;
+
+				for (i = K - 1; i >= 0 && c[i] == ncand - K + i; --i);
+				if (i < 0) break;
+				++c[i];
+				for (j = i + 1; j < K; ++j) c[j] = c[j - 1] + 1;
+			}
+		}
+	}
+};
+
+#endif /* FIXED_SHAPE_ENGINE_HPP_ */
@@ -0,0 +1,279 @@
+/**
+ * @file HEALPix.cpp HEALPix天球等面积划分, NESTED编号
+ */
+#include <math.h>
+#include <algorithm>
+#include "ADefine.h"
+#include "HEALPix.h"
+
+using namespace std;
+using namespace AstroUtil;
+
+static const int jrll[12] = { 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4 };	//< 各基础面南角所在的环
+static const int jpll[12] = { 1, 3, 5, 7, 0, 2, 4, 6, 1, 3, 5, 7 };	//< 各基础面南角的赤经序号
+
+/*!
+ * @brief 相邻像元的面内坐标偏移, 顺序同Neighbours()
+ */
+static const int xoffset[8] = { -1, -1, 0, 1, 1,  1,  0, -1 };
+static const int yoffset[8] = {  0,  1, 1, 1, 0, -1, -1, -1 };
+/*!
+ * @brief 越过基础面边界时所进入的基础面. 行: 越界方向; 列: 当前基础面
+ */
+static const int facearray[9][12] = {
+	{  8,  9, 10, 11, -1, -1, -1, -1, 10, 11,  8,  9 },	// S
+	{  5,  6,  7,  4,  8,  9, 10, 11,  9, 10, 11,  8 },	// SE
+	{ -1, -1, -1, -1,  5,  6,  7,  4, -1, -1, -1, -1 },	// E
+	{  4,  5,  6,  7, 11,  8,  9, 10, 11,  8,  9, 10 },	// SW
+	{  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11 },	// center
+	{  1,  2,  3,  0,  0,  1,  2,  3,  5,  6,  7,  4 },	// NE
+	{ -1, -1, -1, -1,  7,  4,  5,  6, -1, -1, -1, -1 },	// W
+	{  3,  0,  1,  2,  3,  0,  1,  2,  4,  5,  6,  7 },	// NW
+	{  2,  3,  0,  1, -1, -1, -1, -1,  0,  1,  2,  3 }	// N
+};
+/*!
+ * @brief 进入相邻基础面时的坐标变换. 位1: x翻转; 位2: y翻转; 位4: x、y交换.
+ * 行: 越界方向; 列: 当前基础面所在的带(北、赤道、南)
+ */
+static const int swaparray[9][3] = {
+	{ 0, 0, 3 },	// S
+	{ 0, 0, 6 },	// SE
+	{ 0, 0, 0 },	// E
+	{ 0, 0, 5 },	// SW
+	{ 0, 0, 0 },	// center
+	{ 5, 0, 0 },	// NE
+	{ 0, 0, 0 },	// W
+	{ 6, 0, 0 },	// NW
+	{ 3, 0, 0 }		// N
+};
+
+/*!
+ * @brief 将整数的各位间隔展开至偶数位
+ */
+static inline uint64_t spread_bits(uint64_t v) {
+	v &= 0xFFFFFFFFULL;
+	v = (v | (v << 16)) & 0x0000FFFF0000FFFFULL;
+	v = (v | (v << 8))  & 0x00FF00FF00FF00FFULL;
+	v = (v | (v << 4))  & 0x0F0F0F0F0F0F0F0FULL;
+	v = (v | (v << 2))  & 0x3333333333333333ULL;
+	v = (v | (v << 1))  & 0x5555555555555555ULL;
+	return v;
+}
+
+/*!
+ * @brief 提取偶数位, 合并为整数. spread_bits()的逆运算
+ */
+static inline uint64_t compress_bits(uint64_t v) {
+	v &= 0x5555555555555555ULL;
+	v = (v | (v >> 1))  & 0x3333333333333333ULL;
+	v = (v | (v >> 2))  & 0x0F0F0F0F0F0F0F0FULL;
+	v = (v | (v >> 4))  & 0x00FF00FF00FF00FFULL;
+	v = (v | (v >> 8))  & 0x0000FFFF0000FFFFULL;
+	v = (v | (v >> 16)) & 0x00000000FFFFFFFFULL;
+	return v;
+}
+
+HEALPix::HEALPix(int64_t nside) {
+	order_ = 0;
+	nside_ = npface_ = 1;
+	npix_  = 12;
+	fact2_ = 4.0 / npix_;
+	fact1_ = 2 * fact2_;
+	SetNside(nside);
+}
+
+HEALPix::~HEALPix() {
+}
+
+bool HEALPix::ValidNside(int64_t nside) {
+	return nside > 0 && nside <= (int64_t(1) << MAX_ORDER) && !(nside & (nside - 1));
+}
+
+bool HEALPix::SetNside(int64_t nside) {
+	if (!ValidNside(nside)) return false;
+	for (order_ = 0; (int64_t(1) << order_) < nside; ++order_);
+	nside_  = nside;
+	npface_ = nside * nside;
+	npix_   = 12 * npface_;
+	fact2_  = 4.0 / npix_;
+	fact1_  = (nside_ << 1) * fact2_;
+	return true;
+}
+
+double HEALPix::PixelSize() const {
+	return sqrt(4.0 * API / npix_);
+}
+
+double HEALPix::MaxPixelRadius() const {
+	// 极区与赤道带交界处的像元最大: 取其中心与角点的角距
+	double t1 = 1.0 - 1.0 / nside_;
+	double phi = API / (4 * nside_);
+	double za = 2.0 / 3.0, zb = 1.0 - t1 * t1 / 3.0;
+	double sa = sqrt((1.0 - za) * (1.0 + za)), sb = sqrt((1.0 - zb) * (1.0 + zb));
+	double a[3] = { sa * cos(phi), sa * sin(phi), za };
+	double b[3] = { sb, 0.0, zb };
+	double c[3] = { a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0] };
+	return atan2(sqrt(c[0] * c[0] + c[1] * c[1] + c[2] * c[2]), a[0] * b[0] + a[1] * b[1] + a[2] * b[2]);
+}
+
+int64_t HEALPix::xyf2nest(int ix, int iy, int face) const {
+	return (int64_t(face) << (2 * order_)) + spread_bits(ix) + (spread_bits(iy) << 1);
+}
+
+void HEALPix::nest2xyf(int64_t pix, int &ix, int &iy, int &face) const {
+	face = int(pix >> (2 * order_));
+	pix &= npface_ - 1;
+	ix = int(compress_bits(pix));
+	iy = int(compress_bits(pix >> 1));
+}
+
+int64_t HEALPix::loc2pix(double z, double phi, double sth) const {
+	double za = fabs(z);
+	double tt = phi / (API * 0.5);	// 赤经, 量纲: 90度
+	if (tt < 0.0) tt += 4.0;
+	if (tt >= 4.0) tt -= 4.0;
+
+	if (za <= 2.0 / 3.0) {// 赤道带
+		double temp1 = nside_ * (0.5 + tt);
+		double temp2 = nside_ * (z * 0.75);
+		int64_t jp = int64_t(temp1 - temp2);	// 升序边线序号
+		int64_t jm = int64_t(temp1 + temp2);	// 降序边线序号
+		int64_t ifp = jp >> order_;
+		int64_t ifm = jm >> order_;
+		int face = int(ifp == ifm ? (ifp | 4) : (ifp < ifm ? ifp : ifm + 8));
+		int ix = int(jm & (nside_ - 1));
+		int iy = int(nside_ - (jp & (nside_ - 1)) - 1);
+		return xyf2nest(ix, iy, face);
+	}
+
+	// 极区
+	int ntt = min(3, int(tt));
+	double tp = tt - ntt;
+	double tmp = za < 0.99 ? nside_ * sqrt(3.0 * (1.0 - za)) : nside_ * sth / sqrt((1.0 + za) / 3.0);
+	int64_t jp = min(int64_t(tp * tmp), nside_ - 1);
+	int64_t jm = min(int64_t((1.0 - tp) * tmp), nside_ - 1);
+	return z >= 0.0 ? xyf2nest(int(nside_ - jm - 1), int(nside_ - jp - 1), ntt) : xyf2nest(int(jp), int(jm), ntt + 8);
+}
+
+void HEALPix::pix2loc(int64_t pix, double &z, double &sth, double &phi) const {
+	int ix, iy, face, kshift;
+	int64_t nr, jp;
+
+	nest2xyf(pix, ix, iy, face);
+	int64_t jr = (int64_t(jrll[face]) << order_) - ix - iy - 1;	// 环序号
+	if (jr < nside_) {// 北极区
+		nr = jr;
+		double tmp = double(nr) * nr * fact2_;
+		z   = 1.0 - tmp;
+		sth = sqrt(tmp * (2.0 - tmp));
+		kshift = 0;
+	}
+	else if (jr > 3 * nside_) {// 南极区
+		nr = 4 * nside_ - jr;
+		double tmp = double(nr) * nr * fact2_;
+		z   = tmp - 1.0;
+		sth = sqrt(tmp * (2.0 - tmp));
+		kshift = 0;
+	}
+	else {// 赤道带
+		nr = nside_;
+		z   = (2 * nside_ - jr) * fact1_;
+		sth = sqrt((1.0 - z) * (1.0 + z));
+		kshift = int((jr - nside_) & 1);
+	}
+
+	jp = (jpll[face] * nr + ix - iy + 1 + kshift) / 2;
+	if (jp > 4 * nside_) jp -= 4 * nside_;
+	else if (jp < 1) jp += 4 * nside_;
+	phi = (jp - (kshift + 1) * 0.5) * (API * 0.5 / nr);
+}
+
+int64_t HEALPix::Vec2Pix(double x, double y, double z) const {
+	double rxy = sqrt(x * x + y * y);
+	double r = sqrt(rxy * rxy + z * z);
+	double phi = x != 0.0 || y != 0.0 ? atan2(y, x) : 0.0;
+	return loc2pix(z / r, phi, rxy / r);
+}
+
+int64_t HEALPix::Ang2Pix(double ra, double dec) const {
+	return loc2pix(sin(dec), ra, cos(dec));
+}
+
+void HEALPix::Pix2Vec(int64_t pix, double &x, double &y, double &z) const {
+	double sth, phi;
+	pix2loc(pix, z, sth, phi);
+	x = sth * cos(phi);
+	y = sth * sin(phi);
+}
+
+void HEALPix::Pix2Ang(int64_t pix, double &ra, double &dec) const {
+	double z, sth;
+	pix2loc(pix, z, sth, ra);
+	dec = atan2(z, sth);
+}
+
+int64_t HEALPix::Nest2Hilbert(int64_t pix) const {
+	int ix, iy, face;
+	uint64_t d(0);
+
+	nest2xyf(pix, ix, iy, face);
+	uint32_t x(ix), y(iy), n = uint32_t(nside_);
+	for (uint32_t s = n >> 1; s; s >>= 1) {
+		uint32_t rx = (x & s) ? 1 : 0;
+		uint32_t ry = (y & s) ? 1 : 0;
+		d += uint64_t(s) * s * ((3 * rx) ^ ry);
+		if (!ry) {// 旋转子象限, 使曲线首尾相接
+			if (rx) {
+				x = n - 1 - x;
+				y = n - 1 - y;
+			}
+			swap(x, y);
+		}
+	}
+	return (int64_t(face) << (2 * order_)) + int64_t(d);
+}
+
+int HEALPix::Neighbours(int64_t pix, int64_t result[8]) const {
+	int ix, iy, face, i, n(0);
+
+	nest2xyf(pix, ix, iy, face);
+	int nsm1 = int(nside_ - 1);
+	if (ix > 0 && ix < nsm1 && iy > 0 && iy < nsm1) {// 面内
+		for (i = 0; i < 8; ++i) result[i] = xyf2nest(ix + xoffset[i], iy + yoffset[i], face);
+		return 8;
+	}
+
+	for (i = 0; i < 8; ++i) {
+		int x = ix + xoffset[i];
+		int y = iy + yoffset[i];
+		int nbnum = 4;
+		if (x < 0) {
+			x += int(nside_);
+			nbnum -= 1;
+		}
+		else if (x >= nside_) {
+			x -= int(nside_);
+			nbnum += 1;
+		}
+		if (y < 0) {
+			y += int(nside_);
+			nbnum -= 3;
+		}
+		else if (y >= nside_) {
+			y -= int(nside_);
+			nbnum += 3;
+		}
+
+		int f = facearray[nbnum][face];
+		if (f < 0) result[i] = -1;
+		else {
+			int bits = swaparray[nbnum][face >> 2];
+			if (bits & 1) x = int(nside_) - x - 1;
+			if (bits & 2) y = int(nside_) - y - 1;
+			if (bits & 4) swap(x, y);
+			result[i] = xyf2nest(x, y, f);
+			++n;
+		}
+	}
+	return n;
+}
@@ -0,0 +1,145 @@
+/**
+ * @file HEALPix.h HEALPix天球等面积划分, NESTED编号
+ * @note
+ * - Nside须为2的幂, 像元序号由面序号与面内坐标的位交错组合而成
+ * - 某阶的像元序号右移2位即为其上一阶(Nside/2)的像元序号, 因此按最高阶
+ *   像元序号排序的结果, 对任意阶都是按像元排序
+ * - 算法参照: Gorski K.M. et al., 2005, ApJ 622, 759; HEALPix C++库Healpix_Base
+ */
+
+#ifndef HEALPIX_H_
+#define HEALPIX_H_
+
+#include <stdint.h>
+
+class HEALPix {
+public:
+	HEALPix(int64_t nside = 1);
+	virtual ~HEALPix();
+
+public:
+	enum {
+		MAX_ORDER = 29	//< 最高阶数. 像元序号不超过62位
+	};
+
+protected:
+	int order_;			//< 阶数: Nside = 2^order
+	int64_t nside_;		//< 每个基础面的边长像元数
+	int64_t npface_;	//< 每个基础面的像元数
+	int64_t npix_;		//< 全天像元数
+	double fact1_, fact2_;	//< 由像元序号计算z的系数
+
+public:
+	/*!
+	 * @brief 设置Nside
+	 * @param nside  每个基础面的边长像元数, 须为2的幂且不大于2^MAX_ORDER
+	 * @return
+	 * 参数是否有效. 无效时保持原Nside
+	 */
+	bool SetNside(int64_t nside);
+	/*!
+	 * @brief 检查Nside是否有效
+	 */
+	static bool ValidNside(int64_t nside);
+	int64_t Nside() const {
+		return nside_;
+	}
+	int Order() const {
+		return order_;
+	}
+	int64_t Npix() const {
+		return npix_;
+	}
+	/*!
+	 * @brief 像元的平均尺寸, 量纲: 弧度
+	 */
+	double PixelSize() const;
+	/*!
+	 * @brief 像元中心至其角点的最大角距, 量纲: 弧度
+	 */
+	double MaxPixelRadius() const;
+	/*!
+	 * @brief 由矢量计算像元序号
+	 * @param x  矢量X分量
+	 * @param y  矢量Y分量
+	 * @param z  矢量Z分量
+	 * @return
+	 * 像元序号
+	 * @note
+	 * - 矢量不必归一化
+	 */
+	int64_t Vec2Pix(double x, double y, double z) const;
+	/*!
+	 * @brief 由赤道坐标计算像元序号
+	 * @param ra   赤经, 量纲: 弧度
+	 * @param dec  赤纬, 量纲: 弧度
+	 * @return
+	 * 像元序号
+	 */
+	int64_t Ang2Pix(double ra, double dec) const;
+	/*!
+	 * @brief 计算像元中心的单位矢量
+	 * @param pix  像元序号
+	 * @param x    矢量X分量
+	 * @param y    矢量Y分量
+	 * @param z    矢量Z分量
+	 */
+	void Pix2Vec(int64_t pix, double &x, double &y, double &z) const;
+	/*!
+	 * @brief 计算像元中心的赤道坐标
+	 * @param pix  像元序号
+	 * @param ra   赤经, 量纲: 弧度
+	 * @param dec  赤纬, 量纲: 弧度
+	 */
+	void Pix2Ang(int64_t pix, double &ra, double &dec) const;
+	/*!
+	 * @brief 查找相邻像元
+	 * @param pix     像元序号
+	 * @param result  相邻像元, 依次为西南、西、西北、北、东北、东、东南、南.
+	 *                基础面角点处缺失的相邻像元为-1
+	 * @return
+	 * 有效的相邻像元数: 7或8
+	 */
+	int Neighbours(int64_t pix, int64_t result[8]) const;
+	/*!
+	 * @brief 由NESTED像元序号计算面内Hilbert曲线序号
+	 * @param pix  NESTED像元序号
+	 * @return
+	 * 面序号 << (2 * Order()) | 面内Hilbert曲线序号
+	 * @note
+	 * - 与NESTED序号相同, 右移2位即为上一阶像元的Hilbert序号. 按最高阶Hilbert
+	 *   序号排序的结果, 对任意阶都是按像元连续存储, 且相邻像元在曲线上不跳跃
+	 */
+	int64_t Nest2Hilbert(int64_t pix) const;
+	/*!
+	 * @brief 由本阶像元序号计算低阶像元序号
+	 * @param pix    像元序号
+	 * @param order  低阶阶数
+	 */
+	int64_t ParentPixel(int64_t pix, int order) const {
+		return pix >> (2 * (order_ - order));
+	}
+
+protected:
+	/*!
+	 * @brief 由面内坐标与面序号计算像元序号
+	 */
+	int64_t xyf2nest(int ix, int iy, int face) const;
+	/*!
+	 * @brief 由像元序号计算面内坐标与面序号
+	 */
+	void nest2xyf(int64_t pix, int &ix, int &iy, int &face) const;
+	/*!
+	 * @brief 由z=sin(dec)与赤经计算像元序号
+	 * @param z    sin(dec)
+	 * @param phi  赤经, 量纲: 弧度
+	 * @param sth  cos(dec). 用于极区, 避免1-z的精度损失
+	 */
+	int64_t loc2pix(double z, double phi, double sth) const;
+	/*!
+	 * @brief 由像元序号计算中心的z=sin(dec)、cos(dec)与赤经
+	 */
+	void pix2loc(int64_t pix, double &z, double &sth, double &phi) const;
+};
+
+#endif /* HEALPIX_H_ */
@@ -0,0 +1,154 @@
+/**
+ * @file ImplicitTree.hpp 隐式层序kd树的构建与遍历, 供KdTree与CodeTree共用
+ * @note
+ * - 节点按层序存储于数组, 节点i的子节点为2i+1与2i+2. 各节点的元素在树序中连续,
+ *   范围由其序号逐层对半划分得到, 不存储指针与范围
+ * - 划分、取出数据、包围盒的计算与合并由调用者以函数提供
+ */
+
+#ifndef IMPLICIT_TREE_HPP_
+#define IMPLICIT_TREE_HPP_
+
+#include <stddef.h>
+#include <thread>
+#include <vector>
+#include "RunThreads.hpp"
+
+/*!
+ * @struct TreeRange 节点及其元素在树序中的范围
+ */
+struct TreeRange {
+	int node, level;
+	size_t lo, hi;
+};
+
+enum {
+	TREE_SKIP,			//< 不访问子节点
+	TREE_LEFT_FIRST,	//< 先访问左子节点, 结果按树序排列
+	TREE_RIGHT_FIRST	//< 先访问右子节点
+};
+
+/*!
+ * @brief 叶节点所在的层数: 叶节点的元素数不超过leafsize
+ * @param n         元素数
+ * @param leafsize  叶节点的最多元素数
+ */
+inline int implicit_depth(size_t n, int leafsize) {
+	int depth;
+	if (leafsize < 1) leafsize = 1;
+	for (depth = 0; ((n + (size_t(1) << depth) - 1) >> depth) > size_t(leafsize); ++depth);
+	return depth;
+}
+
+/*!
+ * @brief 逐层划分以第level层某节点为根的子树
+ */
+template <class Split>
+void split_implicit_subtree(int level, int depth, size_t lo, size_t hi, const Split &split) {
+	if (level < depth) {
+		size_t mid = lo + (hi - lo) / 2;
+		split(lo, hi);
+		split_implicit_subtree(level + 1, depth, lo, mid, split);
+		split_implicit_subtree(level + 1, depth, mid, hi, split);
+	}
+}
+
+/*!
+ * @brief 计算以node为根的子树中各节点的包围盒
+ */
+template <class Bound, class Merge>
+void bound_implicit_subtree(int node, int level, int depth, size_t lo, size_t hi, const Bound &bound,
+		const Merge &merge) {
+	if (level == depth) bound(node, lo, hi);
+	else {
+		size_t mid = lo + (hi - lo) / 2;
+		bound_implicit_subtree(2 * node + 1, level + 1, depth, lo, mid, bound, merge);
+		bound_implicit_subtree(2 * node + 2, level + 1, depth, mid, hi, bound, merge);
+		merge(node);
+	}
+}
+
+/*!
+ * @brief 并行构建隐式层序kd树
+ * @param n        元素数
+ * @param depth    叶节点所在的层数
+ * @param nthread  线程数. 0: 使用全部硬件线程
+ * @param split    split(lo, hi): 以中位数对半划分树序[lo, hi)的元素
+ * @param gather   gather(lo, hi): 划分完成后, 按树序取出[lo, hi)的数据
+ * @param bound    bound(node, lo, hi): 计算叶节点的包围盒
+ * @param merge    merge(node): 由子节点合并包围盒
+ * @note
+ * - 上层节点逐层并行划分, 之后各线程独立划分一棵子树、取出数据并计算包围盒,
+ *   最后由调用线程合并上层节点的包围盒
+ */
+template <class Split, class Gather, class Bound, class Merge>
+void build_implicit_tree(size_t n, int depth, int nthread, const Split &split, const Gather &gather,
+		const Bound &bound, const Merge &merge) {
+	int level, top(0);
+
+	// 上层节点逐层并行划分: 第level层的节点数为2^level
+	if (nthread <= 0) nthread = std::thread::hardware_concurrency();
+	while ((2 << top) <= nthread && top < depth) ++top;
+	std::vector<size_t> edge(2), next;
+	edge[0] = 0;
+	edge[1] = n;
+	for (level = 0; level < top; ++level) {
+		run_threads(1 << level, [&split, &edge](int t) {
+			split(edge[t], edge[t + 1]);
+		});
+		next.resize((2 << level) + 1);
+		for (int t = 0; t < (1 << level); ++t) {
+			next[2 * t]     = edge[t];
+			next[2 * t + 1] = edge[t] + (edge[t + 1] - edge[t]) / 2;
+		}
+		next.back() = n;
+		edge.swap(next);
+	}
+	// 各线程划分一棵子树, 按树序取出数据, 再计算包围盒
+	int first = (1 << top) - 1;
+	run_threads(1 << top, [first, top, depth, &split, &gather, &bound, &merge, &edge](int t) {
+		size_t lo = edge[t], hi = edge[t + 1];
+		split_implicit_subtree(top, depth, lo, hi, split);
+		gather(lo, hi);
+		bound_implicit_subtree(first + t, top, depth, lo, hi, bound, merge);
+	});
+	for (int node = first - 1; node >= 0; --node) merge(node);
+}
+
+/*!
+ * @brief 以栈遍历隐式层序kd树
+ * @param n      元素数
+ * @param depth  叶节点所在的层数
+ * @param visit  visit(range): 处理节点, 返回TREE_SKIP或子节点的访问顺序. 叶节点的返回值被忽略
+ * @return
+ * 访问的节点数
+ */
+template <class Visit>
+size_t walk_implicit_tree(size_t n, int depth, const Visit &visit) {
+	TreeRange stack[2 * (sizeof(size_t) * 8 + 1)];
+	size_t nvisit(0);
+	int top(0);
+
+	stack[top++] = TreeRange { 0, 0, 0, n };
+	while (top) {
+		TreeRange r = stack[--top];
+		int next = visit(r);
+
+		++nvisit;
+		if (next == TREE_SKIP || r.level == depth) continue;
+		size_t mid = r.lo + (r.hi - r.lo) / 2;
+		TreeRange left  = { 2 * r.node + 1, r.level + 1, r.lo, mid };
+		TreeRange right = { 2 * r.node + 2, r.level + 1, mid, r.hi };
+		if (next == TREE_LEFT_FIRST) {// 后入栈者先出栈
+			stack[top++] = right;
+			stack[top++] = left;
+		}
+		else {
+			stack[top++] = left;
+			stack[top++] = right;
+		}
+	}
+	return nvisit;
+}
+
+#endif /* IMPLICIT_TREE_HPP_ */
@@ -0,0 +1,153 @@
+/**
+ * @file IndexBuilder.cpp 多视场索引构建
+ */
+#include <stdio.h>
+#include <math.h>
+#include <chrono>
+#include <algorithm>
+#include "ADefine.h"
+#include "build_index.h"
+#include "HEALPix.h"
+#include "ZoneIndex.h"
+#include "RunThreads.hpp"
+#include "uniformize.h"
+#include "CodeTree.h"
+#include "IndexBuilder.h"
+
+using namespace std;
+using namespace std::chrono;
+using namespace AstroUtil;
+
+IndexBuilder::IndexBuilder(const StarTable &table, double maglim, int nstar, int scheme, int nside,
+		double epoch, bool quantize)
+	: table_(table) {
+	maglim_ = maglim;
+	nstar_  = nstar;
+	scheme_ = scheme;
+	nside_  = nside;
+	epoch_  = epoch;
+	quantize_ = quantize;
+}
+
+IndexBuilder::~IndexBuilder() {
+}
+
+void IndexBuilder::AddScale(double fov) {
+	vector<ScaleIndex>::iterator it;
+
+	for (it = scales_.begin(); it != scales_.end() && it->fov < fov; ++it);
+	if (it != scales_.end() && fabs(it->fov - fov) < 1E-6) return;
+
+	it = scales_.insert(it, ScaleIndex());
+	it->fov    = fov;
+	it->nside  = uniform_nside(fov);
+	it->quota  = uniform_quota(fov, nstar_, it->nside);
+	it->parent = -1;
+}
+
+void IndexBuilder::uniformize_scales(int nthread) {
+	int i, j, n = int(scales_.size());
+	StarTable::IndexVec sub;
+
+	for (i = 0; i < n; ++i) {
+		ScaleIndex &scale = scales_[i];
+		// 选择像元不大于本视场且每像元保留星数不少于本视场的小视场
+		for (j = i - 1; j >= 0 && (scales_[j].nside < scale.nside || scales_[j].quota < scale.quota); --j);
+		scale.parent = j;
+		if (j < 0) {
+			uniformize(table_, scale.nside, scale.quota, scale.keep, nthread);
+			table_.Gather(scale.keep.data(), scale.keep.size(), scale.stars);
+		}
+		else {
+			const ScaleIndex &parent = scales_[j];
+			uniformize(parent.stars, scale.nside, scale.quota, sub, nthread);
+			parent.stars.Gather(sub.data(), sub.size(), scale.stars);
+			scale.keep.resize(sub.size());
+			for (size_t k = 0; k < sub.size(); ++k) scale.keep[k] = parent.keep[sub[k]];
+		}
+	}
+}
+
+bool IndexBuilder::build_scale(ScaleIndex &scale, const char *pathroot) {
+	// 索引文件存储J2000单位矢量, 其分区与星表排序一致
+	bool rslt = ZoneIndex::Save(index_path(pathroot, maglim_, scheme_, nside_, scale.fov, nstar_).c_str(),
+			scale.stars, scheme_, nside_, epoch_);
+	scale.stars.PropagateVectors(epoch_ - CATALOG_EPOCH);
+	scale.tree.Build(scale.stars, 1);
+	return rslt;
+}
+
+bool IndexBuilder::build_codes(ScaleIndex &scale, const char *pathroot, int nthread) {
+	steady_clock::time_point t0 = steady_clock::now();
+	CodeTree codes;
+	if (nstar_ == 3) {// 二维哈希码以单精度存储, 奇偶性作为标记
+		const TriangleSet &tris = scale.triangles;
+		vector<double> code(tris.code.begin(), tris.code.end());
+		codes.Build(code.data(), tris.star.data(), tris.parity.data(), tris.Size(), 2, 3, nthread,
+				CODE_TREE_LEAFSIZE, quantize_ ? CODE_FIXED16 : CODE_FLOAT);
+	}
+	else {
+		const ShapeSet &shapes = scale.shapes;
+		codes.Build(shapes.code.data(), shapes.star.data(), NULL, shapes.Size(), shapes.dim, shapes.nstar, nthread,
+				CODE_TREE_LEAFSIZE, quantize_ ? CODE_FIXED16 : CODE_DOUBLE);
+	}
+	double secs = duration<double>(steady_clock::now() - t0).count();
+	codes.SetStarList(scale.stars.Size(), scale.stars.Checksum());
+	bool rslt = codes.Save(index_path(pathroot, maglim_, scheme_, nside_, scale.fov, nstar_, true).c_str());
+	printf ("FOV %g degrees: %scode tree of depth %d in %.3f sec%s\n", scale.fov, quantize_ ? "16-bit " : "",
+			codes.Depth(), secs, rslt ? "" : ", failed to save");
+	return rslt;
+}
+
+bool IndexBuilder::Build(const char *pathroot, ShapeEngine *engine, int nthread) {
+	int i, n = int(scales_.size());
+	vector<char> saved(n, 0);
+
+	if (nthread <= 0) nthread = thread::hardware_concurrency();
+	if (nthread < 1) nthread = 1;
+	uniformize_scales(nthread);
+
+	// 各线程依次领取视场, 星数多的视场先处理
+	vector<int> order(n);
+	for (i = 0; i < n; ++i) order[i] = i;
+	sort(order.begin(), order.end(), [this](int a, int b) {
+		return scales_[a].stars.Size() > scales_[b].stars.Size();
+	});
+	int nworker = min(n, nthread);
+	run_threads(nworker, [this, pathroot, nworker, &order, &saved](int t) {
+		for (size_t k = t; k < order.size(); k += nworker) saved[order[k]] = build_scale(scales_[order[k]], pathroot);
+	});
+
+	for (i = 0; i < n; ++i) {
+		const ScaleIndex &scale = scales_[i];
+		printf ("FOV %g degrees: %zu stars, at most %d per cell of %.3f degrees (Nside %d), ",
+				scale.fov, scale.stars.Size(), scale.quota, HEALPix(scale.nside).PixelSize() * R2D, scale.nside);
+		if (scale.parent < 0) printf ("selected from catalog");
+		else printf ("selected from FOV %g", scales_[scale.parent].fov);
+		printf (saved[i] ? "\n" : ", failed to save\n");
+	}
+
+	// 各视场依次以全部线程生成星形
+	ShapeEngine generic(nstar_);
+	TriangleEngine trieng;
+	if (!engine) engine = &generic;
+	for (i = 0; i < n; ++i) {
+		ScaleIndex &scale = scales_[i];
+		size_t nshape, bytes;
+		double secs;
+		if (nstar_ == 3) {
+			nshape = trieng.Build(scale.stars, scale.tree, scale.fov, scale.triangles, nthread);
+			bytes  = scale.triangles.Bytes();
+			secs   = trieng.Seconds();
+		}
+		else {
+			nshape = engine->Build(scale.stars, scale.tree, scale.fov, scale.shapes, nthread);
+			bytes  = scale.shapes.Bytes();
+			secs   = engine->Seconds();
+		}
+		printf ("FOV %g degrees: %zu shapes of %d stars (%.1f MB) in %.3f sec, %.0f shapes per second\n",
+				scale.fov, nshape, nstar_, bytes / 1048576.0, secs, secs > 0.0 ? nshape / secs : 0.0);
+		if (!build_codes(scale, pathroot, nthread)) saved[i] = 0;
+	}
+	return find(saved.begin(), saved.end(), 0) == saved.end();
+}
@@ -0,0 +1,116 @@
+/**
+ * @file IndexBuilder.h 多视场索引构建
+ * @note
+ * - 一次加载、排序的星表供所有视场共用
+ * - 各视场的均匀化星表由小视场至大视场逐级生成: 大视场像元是小视场像元的并集,
+ *   其最亮的K颗星必然属于各子像元最亮的K颗星, 因此小视场每像元保留的星数不少于
+ *   K时, 大视场的选择只需在小视场的结果中进行
+ * - 各视场的kd树与索引文件并行生成. 之后逐个视场以全部线程生成星形: 3颗星时由TriangleEngine
+ *   生成三角形, 否则由ShapeEngine生成
+ * - 指定观测历元时, 各视场的星存储为索引文件后, 将其单位矢量外推至观测历元再构建kd树.
+ *   均匀化选择仍使用J2000位置
+ * - 各视场的星形哈希码以全部线程构建kd树(CodeTree), 存储为tycho2_M<星等>_F<视场>_N<星数>_codes.dat,
+ *   之后即释放.
+ *   三角形的哈希码(b/a, c/a)以单精度存储, 奇偶性存储为标记. 可选以16位定点数存储哈希码
+ */
+
+#ifndef INDEXBUILDER_H_
+#define INDEXBUILDER_H_
+
+#include <vector>
+#include "StarTable.h"
+#include "KdTree.h"
+#include "ShapeEngine.h"
+#include "TriangleEngine.h"
+
+/*!
+ * @struct ScaleIndex 一个视场的索引
+ */
+struct ScaleIndex {
+	double fov;		//< 视场直径, 量纲: 角度
+	int nside;		//< 均匀化像元的Nside
+	int quota;		//< 每个像元保留的星数
+	int parent;		//< 均匀化所基于的视场序号. -1: 完整星表
+	StarTable::IndexVec keep;	//< 保留的星在完整星表中的序号, 升序排列
+	StarTable stars;	//< 保留的星, 保持完整星表的排序. 构建后单位矢量为观测历元
+	KdTree tree;		//< 保留的星的kd树
+	ShapeSet shapes;	//< 4颗及以上星的星形. 星序号为stars中的序号
+	TriangleSet triangles;	//< 3颗星的三角形. 星序号为stars中的序号
+};
+
+class IndexBuilder {
+public:
+	/*!
+	 * @brief 构造函数
+	 * @param table   完整星表. 已由sort_catalog()按scheme排序
+	 * @param maglim  星表的极限星等
+	 * @param nstar   每个星形的星数
+	 * @param scheme  分区方案
+	 * @param nside   HEALPix的Nside. 仅用于HEALPix分区
+	 * @param epoch   观测历元, 量纲: 年
+	 * @param quantize  哈希码kd树是否以16位定点数存储哈希码
+	 */
+	IndexBuilder(const StarTable &table, double maglim, int nstar, int scheme, int nside,
+			double epoch = CATALOG_EPOCH, bool quantize = false);
+	virtual ~IndexBuilder();
+
+protected:
+	const StarTable &table_;	//< 完整星表
+	double maglim_;	//< 极限星等
+	int nstar_;		//< 每个星形的星数
+	int scheme_;	//< 分区方案
+	int nside_;		//< HEALPix分区的Nside
+	double epoch_;	//< 观测历元
+	bool quantize_;	//< 哈希码是否量化存储
+	std::vector<ScaleIndex> scales_;	//< 各视场的索引, 按视场直径升序排列
+
+public:
+	/*!
+	 * @brief 增加一个视场
+	 * @param fov  视场直径, 量纲: 角度
+	 * @note
+	 * - 重复的视场被忽略
+	 */
+	void AddScale(double fov);
+	/*!
+	 * @brief 视场数
+	 */
+	int ScaleCount() const {
+		return int(scales_.size());
+	}
+	/*!
+	 * @brief 取一个视场的索引
+	 */
+	const ScaleIndex &Scale(int i) const {
+		return scales_[i];
+	}
+	/*!
+	 * @brief 构建所有视场的索引与星形, 并存储为文件
+	 * @param pathroot  输出目录
+	 * @param engine    星形生成器, 星数须与构造时相同. NULL: 使用通用实现. 3颗星时不使用
+	 * @param nthread   线程数. 0: 使用全部硬件线程
+	 * @return
+	 * 所有视场的索引与哈希码kd树是否均已存储
+	 * @note
+	 * - 文件路径由index_path()生成, 如tycho2_M<星等>_F<视场>_N<星数>.dat、
+	 *   tycho2_M<星等>_H<Nside>_F<视场>_N<星数>.dat, 哈希码kd树另加后缀_codes.
+	 *   哈希码kd树记录其星表的星数与校验和
+	 */
+	bool Build(const char *pathroot, ShapeEngine *engine = NULL, int nthread = 0);
+
+protected:
+	/*!
+	 * @brief 逐级生成各视场的均匀化星表
+	 */
+	void uniformize_scales(int nthread);
+	/*!
+	 * @brief 生成一个视场的kd树并存储其索引文件
+	 */
+	bool build_scale(ScaleIndex &scale, const char *pathroot);
+	/*!
+	 * @brief 构建一个视场的哈希码kd树并存储为文件
+	 */
+	bool build_codes(ScaleIndex &scale, const char *pathroot, int nthread);
+};
+
+#endif /* INDEXBUILDER_H_ */
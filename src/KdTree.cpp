@@ -0,0 +1,214 @@
+/**
+ * @file KdTree.cpp 星单位矢量的三维kd树
+ */
+#include <math.h>
+#include <limits.h>
+#include <algorithm>
+#include "ADefine.h"
+#include "ImplicitTree.hpp"
+#include "sphere_kernel.h"
+#include "KdTree.h"
+
+using namespace std;
+using namespace AstroUtil;
+
+#define KD_MARGIN	1E-12	//< 弦长平方比较的舍入误差余量
+
+KdTree::KdTree() {
+	depth_ = 0;
+	count_ = 0;
+}
+
+KdTree::~KdTree() {
+}
+
+void KdTree::bound_leaf(int node, size_t lo, size_t hi) {
+	KdNode &nd = nodes_[node];
+	int axis;
+
+	for (axis = 0; axis < 3; ++axis) {
+		nd.lo[axis] = HUGE_VAL;
+		nd.hi[axis] = -HUGE_VAL;
+	}
+	nd.minmag = SHRT_MAX;
+	for (size_t i = lo; i < hi; ++i) {
+		double v[3] = { x_[i], y_[i], z_[i] };
+		for (axis = 0; axis < 3; ++axis) {
+			if (v[axis] < nd.lo[axis]) nd.lo[axis] = v[axis];
+			if (v[axis] > nd.hi[axis]) nd.hi[axis] = v[axis];
+		}
+		if (mag_[i] < nd.minmag) nd.minmag = mag_[i];
+	}
+}
+
+void KdTree::merge_children(int node) {
+	KdNode &nd = nodes_[node];
+	const KdNode &l = nodes_[2 * node + 1];
+	const KdNode &r = nodes_[2 * node + 2];
+
+	for (int axis = 0; axis < 3; ++axis) {
+		nd.lo[axis] = min(l.lo[axis], r.lo[axis]);
+		nd.hi[axis] = max(l.hi[axis], r.hi[axis]);
+	}
+	nd.minmag = min(l.minmag, r.minmag);
+}
+
+void KdTree::split_node(KdPoint *pt, size_t lo, size_t hi) {
+	const size_t nsample(1024);	// 估计分布范围的抽样星数
+	size_t i, n(hi - lo), step = n > nsample ? n / nsample : 1, mid = lo + n / 2;
+	float vmin[3] = { 2.0f, 2.0f, 2.0f }, vmax[3] = { -2.0f, -2.0f, -2.0f };
+	int axis, best(0);
+
+	for (i = lo; i < hi; i += step) {
+		for (axis = 0; axis < 3; ++axis) {
+			if (pt[i].v[axis] < vmin[axis]) vmin[axis] = pt[i].v[axis];
+			if (pt[i].v[axis] > vmax[axis]) vmax[axis] = pt[i].v[axis];
+		}
+	}
+	for (axis = 1; axis < 3; ++axis) {
+		if (vmax[axis] - vmin[axis] > vmax[best] - vmin[best]) best = axis;
+	}
+	nth_element(pt + lo, pt + mid, pt + hi, [best](const KdPoint &a, const KdPoint &b) {
+		return a.v[best] < b.v[best];
+	});
+}
+
+void KdTree::Build(const StarTable &table, int nthread, int leafsize) {
+	size_t i, n = table.Size();
+
+	depth_ = implicit_depth(n, leafsize);
+	count_ = n;
+	nodes_.resize((size_t(2) << depth_) - 1);
+
+	vector<KdPoint> pt(n);
+	for (i = 0; i < n; ++i) {
+		pt[i].v[0]  = float(table.x[i]);
+		pt[i].v[1]  = float(table.y[i]);
+		pt[i].v[2]  = float(table.z[i]);
+		pt[i].index = uint32_t(i);
+	}
+
+	x_.resize(n);
+	y_.resize(n);
+	z_.resize(n);
+	mag_.resize(n);
+	index_.resize(n);
+	build_implicit_tree(n, depth_, nthread,
+		[this, &pt](size_t lo, size_t hi) {
+			split_node(pt.data(), lo, hi);
+		},
+		[this, &table, &pt](size_t lo, size_t hi) {// 按树序取出各列
+			for (size_t j = lo; j < hi; ++j) {
+				uint32_t k = pt[j].index;
+				x_[j]     = table.x[k];
+				y_[j]     = table.y[k];
+				z_[j]     = table.z[k];
+				mag_[j]   = table.mag[k];
+				index_[j] = k;
+			}
+		},
+		[this](int node, size_t lo, size_t hi) { bound_leaf(node, lo, hi); },
+		[this](int node) { merge_children(node); });
+}
+
+/*!
+ * @brief 计算中心至包围盒的最小与最大弦长平方
+ */
+static inline void box_distance(const double lo[3], const double hi[3], const double center[3],
+		double &dmin, double &dmax) {
+	dmin = dmax = 0.0;
+	for (int i = 0; i < 3; ++i) {
+		double a = lo[i] - center[i], b = center[i] - hi[i];
+		double d = a > 0.0 ? a : (b > 0.0 ? b : 0.0);
+		double f = a < b ? -a : -b;	// 至较远边界的距离
+		dmin += d * d;
+		dmax += f * f;
+	}
+}
+
+int KdTree::RangeSearch(const double center[3], double radius, vector<uint32_t> &result) const {
+	result.clear();
+	if (!count_) return 0;
+
+	double cosr = cos(radius * D2R);
+	double chord2 = 2.0 - 2.0 * cosr;
+	walk_implicit_tree(count_, depth_, [&](const TreeRange &r) -> int {
+		const KdNode &nd = nodes_[r.node];
+		double dmin, dmax;
+
+		box_distance(nd.lo, nd.hi, center, dmin, dmax);
+		if (dmin > chord2 + KD_MARGIN) return TREE_SKIP;
+		if (dmax < chord2 - KD_MARGIN) {// 节点完全位于区域内
+			result.insert(result.end(), index_.begin() + r.lo, index_.begin() + r.hi);
+			return TREE_SKIP;
+		}
+		if (r.level == depth_) {
+			size_t n0 = result.size();
+			select_in_cone(x_.data(), y_.data(), z_.data(), NULL, uint32_t(r.lo), uint32_t(r.hi - r.lo),
+					center, cosr, 0, result);
+			for (size_t j = n0; j < result.size(); ++j) result[j] = index_[result[j]];
+			return TREE_SKIP;
+		}
+		return TREE_LEFT_FIRST;
+	});
+	return int(result.size());
+}
+
+/*!
+ * @brief 候选星: 星等与星表序号. 按星等、序号比较
+ */
+typedef pair<int16_t, uint32_t> MagIndex;
+
+/*!
+ * @brief 将候选星加入最大堆, 堆中保留最亮的k颗星
+ */
+static inline void push_candidate(vector<MagIndex> &heap, size_t k, const MagIndex &cand) {
+	if (heap.size() < k) {
+		heap.push_back(cand);
+		push_heap(heap.begin(), heap.end());
+	}
+	else if (cand < heap.front()) {
+		pop_heap(heap.begin(), heap.end());
+		heap.back() = cand;
+		push_heap(heap.begin(), heap.end());
+	}
+}
+
+int KdTree::Brightest(const double center[3], double radius, int k, vector<uint32_t> &result) const {
+	result.clear();
+	if (!count_ || k <= 0) return 0;
+
+	double cosr = cos(radius * D2R);
+	double chord2 = 2.0 - 2.0 * cosr;
+	vector<MagIndex> heap;
+	vector<uint32_t> hits;
+	size_t i;
+
+	heap.reserve(k);
+	walk_implicit_tree(count_, depth_, [&](const TreeRange &r) -> int {
+		const KdNode &nd = nodes_[r.node];
+		double dmin, dmax;
+
+		if (heap.size() == size_t(k) && nd.minmag > heap.front().first) return TREE_SKIP;
+		box_distance(nd.lo, nd.hi, center, dmin, dmax);
+		if (dmin > chord2 + KD_MARGIN) return TREE_SKIP;
+		if (dmax < chord2 - KD_MARGIN) {
+			for (i = r.lo; i < r.hi; ++i) push_candidate(heap, k, MagIndex(mag_[i], index_[i]));
+			return TREE_SKIP;
+		}
+		if (r.level == depth_) {
+			hits.clear();
+			select_in_cone(x_.data(), y_.data(), z_.data(), NULL, uint32_t(r.lo), uint32_t(r.hi - r.lo),
+					center, cosr, 0, hits);
+			for (i = 0; i < hits.size(); ++i) push_candidate(heap, k, MagIndex(mag_[hits[i]], index_[hits[i]]));
+			return TREE_SKIP;
+		}
+		// 先访问较亮的子节点, 尽早收紧星等门限
+		return nodes_[2 * r.node + 1].minmag <= nodes_[2 * r.node + 2].minmag ? TREE_LEFT_FIRST : TREE_RIGHT_FIRST;
+	});
+
+	sort_heap(heap.begin(), heap.end());
+	result.resize(heap.size());
+	for (i = 0; i < heap.size(); ++i) result[i] = heap[i].second;
+	return int(result.size());
+}
@@ -0,0 +1,113 @@
+/**
+ * @file KdTree.h 星单位矢量的三维kd树
+ * @note
+ * - 隐式布局: 节点按层序存储于数组, 节点i的子节点为2i+1与2i+2. 每个节点
+ *   的星在树序中连续, 范围由其序号逐层对半划分得到, 不存储指针与范围
+ * - 各节点只存储包围盒与最亮星等, 星的单位矢量、星等与星表序号按树序
+ *   另行连续存储, 叶节点内的判定由sphere_kernel向量化执行
+ * - 树与检索半径无关, 可供多个视场共用
+ */
+
+#ifndef KDTREE_H_
+#define KDTREE_H_
+
+#include <stdint.h>
+#include <vector>
+#include "StarTable.h"
+
+class KdTree {
+public:
+	KdTree();
+	virtual ~KdTree();
+
+protected:
+	/*!
+	 * @struct KdNode 树节点
+	 */
+	struct KdNode {
+		double lo[3], hi[3];	//< 包围盒
+		int16_t minmag;			//< 节点内最亮星的星等
+	};
+
+	/*!
+	 * @struct KdPoint 构建时的星. 单精度矢量只用于划分, 包围盒由双精度矢量计算
+	 */
+	struct KdPoint {
+		float v[3];		//< 单位矢量
+		uint32_t index;	//< 星表序号
+	};
+
+	int depth_;		//< 叶节点所在的层数. 根节点为第0层
+	size_t count_;	//< 星数
+	std::vector<KdNode> nodes_;	//< 节点, 层序存储
+	StarTable::Column<double>::type x_, y_, z_;	//< 按树序存储的单位矢量
+	StarTable::Column<int16_t>::type mag_;		//< 按树序存储的星等
+	StarTable::IndexVec index_;	//< 按树序存储的星表序号
+
+public:
+	/*!
+	 * @brief 由星表构建kd树
+	 * @param table    星表. 单位矢量已计算
+	 * @param nthread  线程数. 0: 使用全部硬件线程
+	 * @param leafsize 叶节点的最多星数
+	 * @note
+	 * - 每个节点沿分布范围最大(抽样估计)的坐标轴以中位数对半划分.
+	 *   叶节点计算包围盒, 上层节点的包围盒由子节点合并
+	 * - 上层节点逐层并行划分, 之后各线程独立划分一棵子树并按树序取出各列
+	 */
+	void Build(const StarTable &table, int nthread = 0, int leafsize = 16);
+	/*!
+	 * @brief 星数
+	 */
+	size_t Size() const {
+		return count_;
+	}
+	/*!
+	 * @brief 叶节点所在的层数
+	 */
+	int Depth() const {
+		return depth_;
+	}
+	/*!
+	 * @brief 范围检索
+	 * @param center  中心的单位矢量
+	 * @param radius  半径, 量纲: 角度
+	 * @param result  检索结果: 星表序号, 按树序排列
+	 * @return
+	 * 检索到的星数
+	 * @note
+	 * - 包围盒与中心的弦距超过半径对应的弦长时剪枝, 完全位于区域内的节点
+	 *   整体加入结果. 叶节点以点积与cos(radius)比较
+	 */
+	int RangeSearch(const double center[3], double radius, std::vector<uint32_t> &result) const;
+	/*!
+	 * @brief 检索范围内最亮的k颗星
+	 * @param center  中心的单位矢量
+	 * @param radius  半径, 量纲: 角度
+	 * @param k       星数上限
+	 * @param result  检索结果: 星表序号, 按星等升序排列, 星等相同时按星表序号升序
+	 * @return
+	 * 检索到的星数
+	 * @note
+	 * - 结果已有k颗星时, 跳过最亮星暗于其中最暗星的节点
+	 */
+	int Brightest(const double center[3], double radius, int k, std::vector<uint32_t> &result) const;
+
+protected:
+	/*!
+	 * @brief 计算叶节点的包围盒与最亮星等
+	 */
+	void bound_leaf(int node, size_t lo, size_t hi);
+	/*!
+	 * @brief 由子节点合并包围盒与最亮星等
+	 */
+	void merge_children(int node);
+	/*!
+	 * @brief 以中位数对半划分一段星
+	 * @note
+	 * - 划分轴取抽样估计的分布范围最大的坐标轴. 划分轴只影响剪枝效率, 不影响检索结果
+	 */
+	void split_node(KdPoint *pt, size_t lo, size_t hi);
+};
+
+#endif /* KDTREE_H_ */
@@ -0,0 +1,70 @@
+/**
+ * @file MappedFile.hpp 只读内存映射文件
+ */
+
+#ifndef MAPPED_FILE_HPP_
+#define MAPPED_FILE_HPP_
+
+#include <stddef.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/*!
+ * @struct MappedFile 只读内存映射文件
+ */
+struct MappedFile {
+	const char *data;	//< 映射首地址
+	size_t size;		//< 文件长度, 量纲: 字节
+
+public:
+	MappedFile() {
+		data = NULL;
+		size = 0;
+	}
+
+	virtual ~MappedFile() {
+		Unmap();
+	}
+
+private:
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+
+public:
+	/*!
+	 * @brief 映射文件
+	 * @param filepath    文件路径
+	 * @param sequential  是否按顺序访问. false: 随机访问
+	 * @return
+	 * 映射结果
+	 */
+	bool Map(const char *filepath, bool sequential = true) {
+		struct stat st;
+		int fd = open(filepath, O_RDONLY);
+
+		if (fd < 0) return false;
+		if (fstat(fd, &st) || st.st_size <= 0) {
+			close(fd);
+			return false;
+		}
+		void *addr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if (addr == MAP_FAILED) return false;
+		madvise(addr, st.st_size, sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+		data = (const char*) addr;
+		size = st.st_size;
+		return true;
+	}
+
+	void Unmap() {
+		if (data) {
+			munmap((void*) data, size);
+			data = NULL;
+			size = 0;
+		}
+	}
+};
+
+#endif /* MAPPED_FILE_HPP_ */
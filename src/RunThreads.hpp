@@ -0,0 +1,81 @@
+/**
+ * @file RunThreads.hpp 多线程执行同一函数
+ */
+
+#ifndef RUN_THREADS_HPP_
+#define RUN_THREADS_HPP_
+
+#include <stdint.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+/*!
+ * @brief 在多个线程中执行同一函数
+ * @param nthread  线程数
+ * @param func     函数, 参数为线程序号. 序号0在调用线程中执行
+ */
+template <class Func>
+void run_threads(int nthread, const Func &func) {
+	std::vector<std::thread> workers;
+	for (int t = 1; t < nthread; ++t) workers.push_back(std::thread(func, t));
+	func(0);
+	for (size_t t = 0; t < workers.size(); ++t) workers[t].join();
+}
+
+/*!
+ * @brief 以工作窃取方式在多个线程中处理一段序号
+ * @param n        序号数. 处理序号0~n-1
+ * @param nthread  线程数
+ * @param grain    每次领取的序号数
+ * @param func     函数, 参数为线程序号与一段序号[first, last)
+ * @note
+ * - 序号按线程数均分为初始区间. 各线程从自身区间的前端每次领取grain个序号,
+ *   区间耗尽后从其它线程区间的后端窃取剩余的一半
+ * - 区间以(起点 << 32 | 终点)存储为一个原子量, 领取与窃取均为一次比较交换.
+ *   序号只被领取一次, 区间值不会重复出现
+ * - 剩余不超过grain个序号的区间不被窃取, 由其线程自行完成
+ */
+template <class Func>
+void run_stealing(uint32_t n, int nthread, uint32_t grain, const Func &func) {
+	std::vector<std::atomic<uint64_t> > ranges(nthread);
+	if (grain < 1) grain = 1;
+	for (int t = 0; t < nthread; ++t) {
+		uint64_t first = uint64_t(n) * t / nthread, last = uint64_t(n) * (t + 1) / nthread;
+		ranges[t].store(first << 32 | last);
+	}
+
+	run_threads(nthread, [&ranges, nthread, grain, &func](int t) {
+		std::atomic<uint64_t> &own = ranges[t];
+		while (true) {
+			uint64_t r = own.load();
+			uint32_t first = uint32_t(r >> 32), last = uint32_t(r);
+			if (first < last) {// 领取自身区间的前端
+				uint32_t end = last - first > grain ? first + grain : last;
+				if (own.compare_exchange_weak(r, uint64_t(end) << 32 | last)) func(t, first, end);
+				continue;
+			}
+
+			bool stolen = false;
+			for (int k = 1; k < nthread && !stolen; ++k) {// 窃取其它线程区间的后一半
+				std::atomic<uint64_t> &victim = ranges[(t + k) % nthread];
+				uint64_t v = victim.load();
+				uint32_t vfirst = uint32_t(v >> 32), vlast = uint32_t(v);
+				while (!stolen && vfirst < vlast && vlast - vfirst > grain) {
+					uint32_t mid = vfirst + (vlast - vfirst) / 2;
+					if (victim.compare_exchange_weak(v, uint64_t(vfirst) << 32 | mid)) {
+						own.store(uint64_t(mid) << 32 | vlast);
+						stolen = true;
+					}
+					else {
+						vfirst = uint32_t(v >> 32);
+						vlast  = uint32_t(v);
+					}
+				}
+			}
+			if (!stolen) break;
+		}
+	});
+}
+
+#endif /* RUN_THREADS_HPP_ */
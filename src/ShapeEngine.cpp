@@ -0,0 +1,209 @@
+/**
+ * @file ShapeEngine.cpp 星形哈希码生成
+ */
+#include <math.h>
+#include <chrono>
+#include <algorithm>
+#include "ADefine.h"
+#include "RunThreads.hpp"
+#include "ShapeEngine.h"
+
+using namespace std;
+using namespace std::chrono;
+using namespace AstroUtil;
+
+#define SHAPE_GRAIN		64	//< 工作窃取每次领取的参考星数
+
+/*!
+ * @struct ShapeChunk 一次领取的参考星所生成的星形
+ */
+struct ShapeChunk {
+	uint32_t first;	//< 首颗参考星序号
+	int thread;		//< 线程序号
+	size_t offset;	//< 在该线程结果中的首个星形
+	size_t count;	//< 星形数
+};
+
+static inline double dot3(const double *a, const double *b) {
+	return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+static inline void normalize3(double *v) {
+	double s = 1.0 / sqrt(dot3(v, v));
+	v[0] *= s;
+	v[1] *= s;
+	v[2] *= s;
+}
+
+static inline void load3(const StarTable &stars, uint32_t i, double *v) {
+	v[0] = stars.x[i];
+	v[1] = stars.y[i];
+	v[2] = stars.z[i];
+}
+
+ShapeEngine::ShapeEngine(int nstar) {
+	nstar_   = nstar;
+	seconds_ = 0.0;
+}
+
+ShapeEngine::~ShapeEngine() {
+}
+
+void ShapeEngine::MakeCode(const StarTable &stars, uint32_t *star, int nstar, double *code) {
+	double a[3], b[3], m[3], e1[3], e2[3], s[3];
+	double sumx(0.0);
+	int i, j, k = nstar - 2;
+
+	load3(stars, star[0], a);
+	load3(stars, star[1], b);
+	// 切平面: 切点为主干中点, x轴沿AB方向. A、B与切点等距, 因此AB与切点正交
+	for (i = 0; i < 3; ++i) {
+		m[i]  = a[i] + b[i];
+		e1[i] = b[i] - a[i];
+	}
+	normalize3(m);
+	normalize3(e1);
+	e2[0] = m[1] * e1[2] - m[2] * e1[1];
+	e2[1] = m[2] * e1[0] - m[0] * e1[2];
+	e2[2] = m[0] * e1[1] - m[1] * e1[0];
+
+	// A、B的投影坐标为(-t, 0)、(t, 0). 相似变换(x + iy + t) * (1 + i) / 2t 将其映射至(0, 0)、(1, 1)
+	double t = dot3(b, e1) / dot3(b, m);
+	double scale = 0.5 / t;
+	for (i = 0; i < k; ++i) {
+		load3(stars, star[i + 2], s);
+		double w  = 1.0 / dot3(s, m);
+		double px = dot3(s, e1) * w + t;
+		double py = dot3(s, e2) * w;
+		code[2 * i]     = (px - py) * scale;
+		code[2 * i + 1] = (px + py) * scale;
+		sumx += code[2 * i];
+	}
+
+	if (sumx > 0.5 * k) {// 交换A、B: 坐标映射为(1 - x, 1 - y)
+		swap(star[0], star[1]);
+		for (i = 0; i < 2 * k; ++i) code[i] = 1.0 - code[i];
+	}
+	for (i = 1; i < k; ++i) {// 其余星按x坐标升序排列
+		for (j = i; j > 0 && code[2 * j] < code[2 * j - 2]; --j) {
+			swap(code[2 * j], code[2 * j - 2]);
+			swap(code[2 * j + 1], code[2 * j - 1]);
+			swap(star[j + 2], star[j + 1]);
+		}
+	}
+}
+
+size_t ShapeEngine::Neighbours(const StarTable &stars, const KdTree &tree, uint32_t ref, double radius,
+		vector<uint32_t> &nb) {
+	auto brighter = [&stars](uint32_t p, uint32_t q) {
+		return stars.mag[p] < stars.mag[q] || (stars.mag[p] == stars.mag[q] && p < q);
+	};
+	double a[3];
+
+	load3(stars, ref, a);
+	tree.RangeSearch(a, radius, nb);
+	nb.erase(remove_if(nb.begin(), nb.end(), [&brighter, ref](uint32_t p) { return !brighter(ref, p); }), nb.end());
+	if (nb.size() > SHAPE_NEIGHBOUR) {
+		partial_sort(nb.begin(), nb.begin() + SHAPE_NEIGHBOUR, nb.end(), brighter);
+		nb.resize(SHAPE_NEIGHBOUR);
+	}
+	else sort(nb.begin(), nb.end(), brighter);
+	return nb.size();
+}
+
+bool ShapeEngine::CodeWithin(const double *code1, const double *code2, int dim, double tol) {
+	for (int j = 0; j < dim; ++j) {
+		if (fabs(code1[j] - code2[j]) > tol) return false;
+	}
+	return true;
+}
+
+void ShapeEngine::shapes_of(const StarTable &stars, const KdTree &tree, uint32_t ref, double rmax, double cosmin,
+		vector<uint32_t> &nb, vector<uint32_t> &cand, ShapeSet &out) const {
+	double a[3], b[3], m[3], s[3];
+	uint32_t shape[SHAPE_MAX_STAR];
+	int c[SHAPE_MAX_STAR], i, j, nstar = nstar_, k = nstar - 2, nshape(0);
+
+	if (Neighbours(stars, tree, ref, rmax, nb) < size_t(nstar - 1)) return;
+	load3(stars, ref, a);
+
+	for (size_t ib = 0; ib < nb.size() && nshape < SHAPE_PER_STAR; ++ib) {
+		load3(stars, nb[ib], b);
+		if (dot3(a, b) > cosmin) continue;	// 主干过短
+		for (i = 0; i < 3; ++i) m[i] = a[i] + b[i];
+		normalize3(m);
+		double cosh2 = dot3(a, m);	// 主干半长的余弦
+
+		cand.clear();
+		for (size_t ic = 0; ic < nb.size(); ++ic) {// 以AB为直径的圆内的星
+			if (ic == ib) continue;
+			load3(stars, nb[ic], s);
+			if (dot3(s, m) > cosh2) cand.push_back(nb[ic]);
+		}
+		if (int(cand.size()) < k) continue;
+
+		// 按亮度顺序枚举其余星的组合
+		for (i = 0; i < k; ++i) c[i] = i;
+		for (int n = 0; n < SHAPE_PER_BACKBONE && nshape < SHAPE_PER_STAR; ++n) {
+			shape[0] = ref;
+			shape[1] = nb[ib];
+			for (i = 0; i < k; ++i) shape[i + 2] = cand[c[i]];
+			size_t n0 = out.code.size();
+			out.code.resize(n0 + 2 * k);
+			MakeCode(stars, shape, nstar, &out.code[n0]);
+			out.star.insert(out.star.end(), shape, shape + nstar);
+			++nshape;
+
+			for (i = k - 1; i >= 0 && c[i] == int(cand.size()) - k + i; --i);
+			if (i < 0) break;
+			++c[i];
+			for (j = i + 1; j < k; ++j) c[j] = c[j - 1] + 1;
+		}
+	}
+}
+
+size_t ShapeEngine::Build(const StarTable &stars, const KdTree &tree, double fov, ShapeSet &shapes, int nthread) {
+	steady_clock::time_point t0 = steady_clock::now();
+	uint32_t n = uint32_t(stars.Size());
+	double rmax = fov * SHAPE_MAX_SCALE;
+	double cosmin = cos(fov * SHAPE_MIN_SCALE * D2R);
+	int k;
+
+	shapes.Reset(nstar_);
+	if (nthread <= 0) nthread = thread::hardware_concurrency();
+	if (nthread < 1) nthread = 1;
+	vector<ShapeSet> part(nthread);
+	vector<vector<ShapeChunk> > chunks(nthread);
+	vector<vector<uint32_t> > nbs(nthread), cands(nthread);
+	for (k = 0; k < nthread; ++k) part[k].Reset(nstar_);
+
+	run_stealing(n, nthread, SHAPE_GRAIN, [&](int t, uint32_t first, uint32_t last) {
+		ShapeChunk chunk = { first, t, part[t].Size(), 0 };
+		for (uint32_t i = first; i < last; ++i) {
+			shapes_of(stars, tree, i, rmax, cosmin, nbs[t], cands[t], part[t]);
+		}
+		chunk.count = part[t].Size() - chunk.offset;
+		if (chunk.count) chunks[t].push_back(chunk);
+	});
+
+	// 按参考星序号合并各线程的结果
+	vector<ShapeChunk> all;
+	for (k = 0; k < nthread; ++k) all.insert(all.end(), chunks[k].begin(), chunks[k].end());
+	sort(all.begin(), all.end(), [](const ShapeChunk &p, const ShapeChunk &q) {
+		return p.first < q.first;
+	});
+	size_t total(0);
+	for (size_t i = 0; i < all.size(); ++i) total += all[i].count;
+	shapes.code.reserve(total * shapes.dim);
+	shapes.star.reserve(total * shapes.nstar);
+	for (size_t i = 0; i < all.size(); ++i) {
+		const ShapeSet &src = part[all[i].thread];
+		size_t first = all[i].offset, last = all[i].offset + all[i].count;
+		shapes.code.insert(shapes.code.end(), src.code.begin() + first * src.dim, src.code.begin() + last * src.dim);
+		shapes.star.insert(shapes.star.end(), src.star.begin() + first * src.nstar,
+				src.star.begin() + last * src.nstar);
+	}
+
+	seconds_ = duration<double>(steady_clock::now() - t0).count();
+	return shapes.Size();
+}
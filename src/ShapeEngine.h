@@ -0,0 +1,144 @@
+/**
+ * @file ShapeEngine.h 星形哈希码生成
+ * @note
+ * - 参照Astrometry.net的四边形(quad)哈希: 星形中相距最远的两颗星A、B构成主干, 其余星位于以AB
+ *   为直径的圆内. 以主干中点为切点作心射投影, 再以相似变换将A映射至(0, 0)、B映射至(1, 1),
+ *   其余星的坐标构成与平移、旋转、缩放无关的哈希码, 维数为2*(N-2). N=4时即四边形
+ * - 哈希码的约束: 其余星的x坐标之和不大于(N-2)/2, 否则交换A、B; 其余星按x坐标升序排列
+ * - 每颗星作为参考星A, 只与暗于其的邻星构成星形, 因此同一组星只在其最亮星处生成一次
+ * - 参考星以工作窃取方式分配给各线程. 生成结果按参考星序号合并, 与线程数无关
+ * - ShapeEngine为通用实现, 星数在运行时确定. FixedShapeEngine.hpp以星数为模板参数特化
+ */
+
+#ifndef SHAPEENGINE_H_
+#define SHAPEENGINE_H_
+
+#include <stdint.h>
+#include <vector>
+#include "StarTable.h"
+#include "KdTree.h"
+
+#define SHAPE_MAX_STAR		10		//< 星形的星数上限
+#define SHAPE_MIN_SCALE		0.1		//< 主干长度下限与视场直径之比
+#define SHAPE_MAX_SCALE		0.5		//< 主干长度上限与视场直径之比
+#define SHAPE_NEIGHBOUR		16		//< 参考星参与构成星形的邻星数上限
+#define SHAPE_PER_BACKBONE	2		//< 每条主干的星形数上限
+#define SHAPE_PER_STAR		8		//< 每颗参考星的星形数上限
+
+/*!
+ * @struct ShapeSet 一组星形
+ */
+struct ShapeSet {
+	int nstar;	//< 每个星形的星数
+	int dim;	//< 哈希码维数
+	std::vector<double> code;	//< 哈希码, 每个星形dim个
+	std::vector<uint32_t> star;	//< 星序号: A、B及其余星, 每个星形nstar个
+
+public:
+	ShapeSet() {
+		nstar = dim = 0;
+	}
+	/*!
+	 * @brief 星形数
+	 */
+	size_t Size() const {
+		return nstar ? star.size() / nstar : 0;
+	}
+	/*!
+	 * @brief 存储量, 量纲: 字节
+	 */
+	size_t Bytes() const {
+		return code.size() * sizeof(double) + star.size() * sizeof(uint32_t);
+	}
+	/*!
+	 * @brief 清除所有星形并设置星数
+	 */
+	void Reset(int n) {
+		nstar = n;
+		dim   = 2 * (n - 2);
+		code.clear();
+		star.clear();
+	}
+};
+
+class ShapeEngine {
+public:
+	/*!
+	 * @brief 构造函数
+	 * @param nstar  每个星形的星数, 3~10
+	 */
+	ShapeEngine(int nstar);
+	virtual ~ShapeEngine();
+
+protected:
+	int nstar_;		//< 每个星形的星数
+	double seconds_;	//< 最近一次生成的耗时, 量纲: 秒
+
+public:
+	/*!
+	 * @brief 生成一个视场的星形
+	 * @param stars    均匀化星表. 单位矢量已外推至观测历元
+	 * @param tree     由stars构建的kd树
+	 * @param fov      视场直径, 量纲: 角度
+	 * @param shapes   生成的星形. 星序号为stars中的序号
+	 * @param nthread  线程数. 0: 使用全部硬件线程
+	 * @return
+	 * 星形数
+	 * @note
+	 * - 主干长度介于视场直径的SHAPE_MIN_SCALE与SHAPE_MAX_SCALE倍之间
+	 * - 每颗参考星取邻域内最亮的SHAPE_NEIGHBOUR颗暗星, 依亮度顺序选择B及其余星,
+	 *   每条主干最多生成SHAPE_PER_BACKBONE个星形, 每颗参考星最多SHAPE_PER_STAR个
+	 */
+	size_t Build(const StarTable &stars, const KdTree &tree, double fov, ShapeSet &shapes, int nthread = 0);
+	/*!
+	 * @brief 最近一次生成的耗时, 量纲: 秒
+	 */
+	double Seconds() const {
+		return seconds_;
+	}
+	/*!
+	 * @brief 计算星形的哈希码
+	 * @param stars  星表
+	 * @param star   星序号: A、B及其余星, nstar个. 必要时交换A、B并重排其余星
+	 * @param nstar  星数
+	 * @param code   哈希码, 2*(nstar-2)维
+	 */
+	static void MakeCode(const StarTable &stars, uint32_t *star, int nstar, double *code);
+	/*!
+	 * @brief 选择参与构成星形的邻星
+	 * @param stars   星表
+	 * @param tree    由stars构建的kd树
+	 * @param ref     参考星序号
+	 * @param radius  邻域半径, 量纲: 角度
+	 * @param nb      邻星序号: 暗于参考星的最亮SHAPE_NEIGHBOUR颗星, 按星等、序号升序排列
+	 * @return
+	 * 邻星数
+	 */
+	static size_t Neighbours(const StarTable &stars, const KdTree &tree, uint32_t ref, double radius,
+			std::vector<uint32_t> &nb);
+	/*!
+	 * @brief 判定两个哈希码的各维之差是否均不超过容差
+	 * @param code1  哈希码
+	 * @param code2  哈希码
+	 * @param dim    维数
+	 * @param tol    容差
+	 */
+	static bool CodeWithin(const double *code1, const double *code2, int dim, double tol);
+
+protected:
+	/*!
+	 * @brief 生成以一颗星为参考星的星形
+	 * @param stars   星表
+	 * @param tree    kd树
+	 * @param ref     参考星序号
+	 * @param rmax    主干长度上限, 量纲: 角度
+	 * @param cosmin  主干长度下限的余弦
+	 * @param nb      邻星缓存
+	 * @param cand    其余星候选缓存
+	 * @param out     生成的星形
+	 */
+	virtual void shapes_of(const StarTable &stars, const KdTree &tree, uint32_t ref, double rmax, double cosmin,
+			std::vector<uint32_t> &nb, std::vector<uint32_t> &cand, ShapeSet &out) const;
+};
+
+#endif /* SHAPEENGINE_H_ */
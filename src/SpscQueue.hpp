@@ -0,0 +1,74 @@
+/**
+ * @file SpscQueue.hpp 单生产者-单消费者无锁有界队列
+ * @note
+ * - 环形缓冲区, 生产者只写尾指针, 消费者只写头指针, 以acquire/release同步
+ * - 容量取不小于指定值的2的幂
+ */
+
+#ifndef SPSC_QUEUE_HPP_
+#define SPSC_QUEUE_HPP_
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+template <class T>
+class SpscQueue {
+protected:
+	std::vector<T> slots_;	//< 存储区
+	size_t mask_;			//< 下标掩码
+	alignas(64) std::atomic<size_t> head_;	//< 消费位置
+	alignas(64) std::atomic<size_t> tail_;	//< 生产位置
+
+public:
+	explicit SpscQueue(size_t capacity) : head_(0), tail_(0) {
+		size_t n(2);
+		while (n < capacity) n <<= 1;
+		slots_.resize(n);
+		mask_ = n - 1;
+	}
+
+	/*!
+	 * @brief 尝试入队
+	 * @return
+	 * 队列已满时返回false
+	 */
+	bool TryPush(const T &x) {
+		size_t tail = tail_.load(std::memory_order_relaxed);
+		if (tail - head_.load(std::memory_order_acquire) > mask_) return false;
+		slots_[tail & mask_] = x;
+		tail_.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	/*!
+	 * @brief 尝试出队
+	 * @return
+	 * 队列为空时返回false
+	 */
+	bool TryPop(T &x) {
+		size_t head = head_.load(std::memory_order_relaxed);
+		if (head == tail_.load(std::memory_order_acquire)) return false;
+		x = slots_[head & mask_];
+		head_.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	/*!
+	 * @brief 入队. 队列满时让出CPU并重试
+	 */
+	void Push(const T &x) {
+		while (!TryPush(x)) std::this_thread::yield();
+	}
+
+	/*!
+	 * @brief 出队. 队列空时让出CPU并重试
+	 */
+	T Pop() {
+		T x;
+		while (!TryPop(x)) std::this_thread::yield();
+		return x;
+	}
+};
+
+#endif /* SPSC_QUEUE_HPP_ */
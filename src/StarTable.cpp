@@ -0,0 +1,194 @@
+/**
+ * @file StarTable.cpp 列存储星表
+ */
+#include <string.h>
+#include "ADefine.h"
+#include "sphere_kernel.h"
+#include "StarTable.h"
+
+using namespace std;
+using namespace AstroUtil;
+
+/*!
+ * @brief 按序号取出一列的部分元素
+ * @param src    源列
+ * @param index  序号表
+ * @param n      序号数
+ * @param dst    目标列
+ */
+template <class C>
+static void gather_column(const C &src, const uint32_t *index, size_t n, C &dst) {
+	dst.resize(n);
+	for (size_t i = 0; i < n; ++i) dst[i] = src[index[i]];
+}
+
+/*!
+ * @brief 按序号重排一列
+ */
+template <class C>
+static void permute_column(C &col, const StarTable::IndexVec &index) {
+	C tmp;
+	gather_column(col, index.data(), index.size(), tmp);
+	col.swap(tmp);
+}
+
+void StarTable::Clear() {
+	StarTable().Swap(*this);
+}
+
+void StarTable::Reserve(size_t n) {
+	ra.reserve(n);
+	spd.reserve(n);
+	pmra.reserve(n);
+	pmdc.reserve(n);
+	mag.reserve(n);
+	x.reserve(n);
+	y.reserve(n);
+	z.reserve(n);
+}
+
+void StarTable::Resize(size_t n) {
+	ra.resize(n);
+	spd.resize(n);
+	pmra.resize(n);
+	pmdc.resize(n);
+	mag.resize(n);
+	x.resize(n);
+	y.resize(n);
+	z.resize(n);
+}
+
+/*!
+ * @brief 在一列内移动一段元素
+ */
+template <class C>
+static void move_column(C &col, size_t from, size_t n, size_t to) {
+	if (n && from != to) memmove(&col[to], &col[from], n * sizeof(typename C::value_type));
+}
+
+void StarTable::Move(size_t from, size_t n, size_t to) {
+	move_column(ra, from, n, to);
+	move_column(spd, from, n, to);
+	move_column(pmra, from, n, to);
+	move_column(pmdc, from, n, to);
+	move_column(mag, from, n, to);
+	move_column(x, from, n, to);
+	move_column(y, from, n, to);
+	move_column(z, from, n, to);
+}
+
+void StarTable::Insert(size_t pos, const CatStar *star, size_t n) {
+	ra.insert(ra.begin() + pos, n, 0);
+	spd.insert(spd.begin() + pos, n, 0);
+	pmra.insert(pmra.begin() + pos, n, 0);
+	pmdc.insert(pmdc.begin() + pos, n, 0);
+	mag.insert(mag.begin() + pos, n, 0);
+	x.insert(x.begin() + pos, n, 0.0);
+	y.insert(y.begin() + pos, n, 0.0);
+	z.insert(z.begin() + pos, n, 0.0);
+	for (size_t i = 0; i < n; ++i) Set(pos + i, star[i]);
+}
+
+void StarTable::Swap(StarTable &other) {
+	ra.swap(other.ra);
+	spd.swap(other.spd);
+	pmra.swap(other.pmra);
+	pmdc.swap(other.pmdc);
+	mag.swap(other.mag);
+	x.swap(other.x);
+	y.swap(other.y);
+	z.swap(other.z);
+}
+
+void StarTable::Append(const CatStar &star) {
+	ra.push_back(star.ra);
+	spd.push_back(star.spd);
+	pmra.push_back(star.pmra);
+	pmdc.push_back(star.pmdc);
+	mag.push_back(star.mag);
+	x.push_back(0.0);
+	y.push_back(0.0);
+	z.push_back(0.0);
+}
+
+void StarTable::Append(const CatStar *star, size_t n) {
+	size_t i0 = Size();
+
+	Resize(i0 + n);
+	for (size_t i = 0; i < n; ++i) Set(i0 + i, star[i]);
+}
+
+void StarTable::Set(size_t i, const CatStar &star) {
+	ra[i]   = star.ra;
+	spd[i]  = star.spd;
+	pmra[i] = star.pmra;
+	pmdc[i] = star.pmdc;
+	mag[i]  = star.mag;
+}
+
+CatStar StarTable::At(size_t i) const {
+	CatStar star;
+	star.ra   = ra[i];
+	star.spd  = spd[i];
+	star.pmra = pmra[i];
+	star.pmdc = pmdc[i];
+	star.mag  = mag[i];
+	return star;
+}
+
+void StarTable::UpdateVectors(size_t first) {
+	const double scale = MAS2D * D2R;
+	size_t n = Size();
+
+	for (size_t i = first; i < n; ++i) {
+		double alpha = ra[i] * scale;
+		double delta = spd[i] * scale - API * 0.5;
+		double cd = cos(delta);
+		x[i] = cd * cos(alpha);
+		y[i] = cd * sin(alpha);
+		z[i] = sin(delta);
+	}
+}
+
+void StarTable::PropagateVectors(double years) {
+	if (years == 0.0 || Empty()) return;
+	propagate_vectors(x.data(), y.data(), z.data(), pmra.data(), pmdc.data(), Size(), years,
+			x.data(), y.data(), z.data());
+}
+
+void StarTable::Permute(const IndexVec &index) {
+	permute_column(ra, index);
+	permute_column(spd, index);
+	permute_column(pmra, index);
+	permute_column(pmdc, index);
+	permute_column(mag, index);
+	permute_column(x, index);
+	permute_column(y, index);
+	permute_column(z, index);
+}
+
+void StarTable::Gather(const uint32_t *index, size_t n, StarTable &out) const {
+	gather_column(ra, index, n, out.ra);
+	gather_column(spd, index, n, out.spd);
+	gather_column(pmra, index, n, out.pmra);
+	gather_column(pmdc, index, n, out.pmdc);
+	gather_column(mag, index, n, out.mag);
+	gather_column(x, index, n, out.x);
+	gather_column(y, index, n, out.y);
+	gather_column(z, index, n, out.z);
+}
+
+uint64_t StarTable::Checksum() const {
+	uint64_t hash(14695981039346656037ULL);
+	auto mix = [&hash](const void *data, size_t size) {
+		const uint8_t *p = (const uint8_t*) data;
+		for (size_t i = 0; i < size; ++i) hash = (hash ^ p[i]) * 1099511628211ULL;
+	};
+
+	for (size_t i = 0, n = Size(); i < n; ++i) {
+		mix(&ra[i], sizeof(int32_t));
+		mix(&spd[i], sizeof(int32_t));
+		mix(&mag[i], sizeof(int16_t));
+	}
+	return hash;
+}
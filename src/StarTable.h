@@ -0,0 +1,200 @@
+/**
+ * @file StarTable.h 列存储星表
+ * @note
+ * - 每个字段独立存储为64字节对齐的连续数组, 各处理阶段只访问其所需的列
+ * - 单位矢量在J2000坐标确定后预先计算
+ * - 排序等操作只移动序号, 最后由Permute()一次性重排各列
+ */
+
+#ifndef STARTABLE_H_
+#define STARTABLE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <new>
+#include <vector>
+#include "build_index.h"
+
+/*!
+ * @class AlignedAllocator 按指定字节数对齐的内存分配器
+ * @note
+ * - 无参构造元素时执行默认初始化而非值初始化
+ */
+template <class T, size_t Align = 64>
+class AlignedAllocator {
+public:
+	typedef T value_type;
+	typedef T* pointer;
+	typedef const T* const_pointer;
+	typedef T& reference;
+	typedef const T& const_reference;
+	typedef size_t size_type;
+	typedef ptrdiff_t difference_type;
+
+	template <class U> struct rebind {
+		typedef AlignedAllocator<U, Align> other;
+	};
+
+public:
+	AlignedAllocator() {}
+	template <class U> AlignedAllocator(const AlignedAllocator<U, Align>&) {}
+
+	pointer allocate(size_type n, const void* = 0) {
+		void *p;
+		if (posix_memalign(&p, Align, n * sizeof(T) > 0 ? n * sizeof(T) : Align)) throw std::bad_alloc();
+		return (pointer) p;
+	}
+
+	void deallocate(pointer p, size_type) {
+		free(p);
+	}
+
+	size_type max_size() const {
+		return size_type(-1) / sizeof(T);
+	}
+
+	/*!
+	 * @brief 默认构造. 数值类型不初始化, 扩展列长度时不触及新增内存页
+	 */
+	template <class U> void construct(U *p) {
+		::new((void*) p) U;
+	}
+
+	template <class U, class... Args> void construct(U *p, Args&&... args) {
+		::new((void*) p) U(std::forward<Args>(args)...);
+	}
+
+	template <class U> void destroy(U *p) {
+		p->~U();
+	}
+
+	template <class U> bool operator==(const AlignedAllocator<U, Align>&) const {
+		return true;
+	}
+
+	template <class U> bool operator!=(const AlignedAllocator<U, Align>&) const {
+		return false;
+	}
+};
+
+/*!
+ * @class StarTable 列存储星表
+ */
+class StarTable {
+public:
+	template <class T> struct Column {
+		typedef std::vector<T, AlignedAllocator<T> > type;
+	};
+	typedef std::vector<uint32_t> IndexVec;
+
+public:
+	Column<int32_t>::type ra, spd;		//< J2000坐标, 量纲: 毫角秒
+	Column<int16_t>::type pmra, pmdc;	//< 自行, 量纲: 毫角秒/年
+	Column<int16_t>::type mag;			//< 0.001星等
+	Column<double>::type x, y, z;		//< 单位矢量
+
+public:
+	/*!
+	 * @brief 星数
+	 */
+	size_t Size() const {
+		return ra.size();
+	}
+	/*!
+	 * @brief 是否为空
+	 */
+	bool Empty() const {
+		return ra.empty();
+	}
+	/*!
+	 * @brief 清除所有星并释放存储区
+	 */
+	void Clear();
+	/*!
+	 * @brief 预分配存储区
+	 * @param n  星数
+	 */
+	void Reserve(size_t n);
+	/*!
+	 * @brief 改变星数. 新增的星不初始化
+	 * @param n  星数
+	 */
+	void Resize(size_t n);
+	/*!
+	 * @brief 将一段星移至更小的序号处
+	 * @param from  源起始序号
+	 * @param n     星数
+	 * @param to    目标起始序号, to <= from
+	 */
+	void Move(size_t from, size_t n, size_t to);
+	/*!
+	 * @brief 在指定位置插入多颗星. 单位矢量由UpdateVectors()计算
+	 * @param pos   插入位置
+	 * @param star  星数据
+	 * @param n     星数
+	 */
+	void Insert(size_t pos, const CatStar *star, size_t n);
+	/*!
+	 * @brief 交换两星表的数据
+	 */
+	void Swap(StarTable &other);
+	/*!
+	 * @brief 追加一颗星. 单位矢量由UpdateVectors()计算
+	 * @param star  星数据
+	 */
+	void Append(const CatStar &star);
+	/*!
+	 * @brief 追加多颗星. 单位矢量由UpdateVectors()计算
+	 * @param star  星数据
+	 * @param n     星数
+	 */
+	void Append(const CatStar *star, size_t n);
+	/*!
+	 * @brief 改写一颗星的坐标、自行与星等
+	 * @param i     序号
+	 * @param star  星数据
+	 */
+	void Set(size_t i, const CatStar &star);
+	/*!
+	 * @brief 以行记录形式取出一颗星
+	 * @param i  序号
+	 * @return
+	 * 星数据
+	 */
+	CatStar At(size_t i) const;
+	/*!
+	 * @brief 由J2000坐标计算单位矢量
+	 * @param first  起始序号. 之前的星视为已计算
+	 */
+	void UpdateVectors(size_t first = 0);
+	/*!
+	 * @brief 由自行将单位矢量外推至观测历元
+	 * @param years  观测历元与当前单位矢量历元之差, 量纲: 年
+	 * @note
+	 * - 只改写单位矢量, J2000坐标不变
+	 */
+	void PropagateVectors(double years);
+	/*!
+	 * @brief 按序号重排各列
+	 * @param index  序号表. 重排后第i颗星为重排前第index[i]颗星
+	 * @note
+	 * - index须为0~Size()-1的一个排列
+	 */
+	void Permute(const IndexVec &index);
+	/*!
+	 * @brief 按序号取出部分星, 构成新星表
+	 * @param index  序号表
+	 * @param n      序号数
+	 * @param out    新星表
+	 */
+	void Gather(const uint32_t *index, size_t n, StarTable &out) const;
+	/*!
+	 * @brief 星表校验和: 按序号对各星的J2000坐标与星等计算64位FNV-1a散列
+	 * @note
+	 * - 用于确认星形的星序号所指向的星表. 与单位矢量及其历元无关
+	 */
+	uint64_t Checksum() const;
+};
+
+#endif /* STARTABLE_H_ */
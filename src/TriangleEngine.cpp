@@ -0,0 +1,163 @@
+/**
+ * @file TriangleEngine.cpp 三角形哈希码生成与检索
+ */
+#include <math.h>
+#include <chrono>
+#include <algorithm>
+#include "ADefine.h"
+#include "RunThreads.hpp"
+#include "ShapeEngine.h"
+#include "TriangleEngine.h"
+
+using namespace std;
+using namespace std::chrono;
+using namespace AstroUtil;
+
+#define TRIANGLE_GRAIN	64	//< 工作窃取每次领取的参考星数
+
+int TriangleSet::Lookup(double r1, double r2, int par, double tol, vector<uint32_t> &result) const {
+	size_t n = Size();
+	result.clear();
+
+	// 首个b/a不小于r1 - tol的三角形
+	size_t lo(0), hi(n);
+	float lower = float(r1 - tol);
+	while (lo < hi) {
+		size_t mid = (lo + hi) / 2;
+		if (code[2 * mid] < lower) lo = mid + 1;
+		else hi = mid;
+	}
+	for (size_t i = lo; i < n && code[2 * i] <= r1 + tol; ++i) {
+		if (fabs(code[2 * i + 1] - r2) <= tol && (par < 0 || parity[i] == par)) result.push_back(uint32_t(i));
+	}
+	return int(result.size());
+}
+
+TriangleEngine::TriangleEngine() {
+	seconds_ = 0.0;
+}
+
+TriangleEngine::~TriangleEngine() {
+}
+
+void TriangleEngine::MakeCode(const StarTable &stars, uint32_t *star, float *code, uint8_t &parity) {
+	double v[3][3], side[3];
+	int i, j, order[3] = { 0, 1, 2 };
+
+	for (i = 0; i < 3; ++i) {
+		v[i][0] = stars.x[star[i]];
+		v[i][1] = stars.y[star[i]];
+		v[i][2] = stars.z[star[i]];
+	}
+	for (i = 0; i < 3; ++i) {// 顶点i的对边弦长
+		const double *p = v[(i + 1) % 3], *q = v[(i + 2) % 3];
+		double dx = p[0] - q[0], dy = p[1] - q[1], dz = p[2] - q[2];
+		side[i] = sqrt(dx * dx + dy * dy + dz * dz);
+	}
+	// 顶点按对边由长至短排列. 边长相同时按原顺序
+	for (i = 1; i < 3; ++i) {
+		for (j = i; j > 0 && side[order[j]] > side[order[j - 1]]; --j) swap(order[j], order[j - 1]);
+	}
+	code[0] = float(side[order[1]] / side[order[0]]);
+	code[1] = float(side[order[2]] / side[order[0]]);
+
+	const double *a = v[order[0]], *b = v[order[1]], *c = v[order[2]];
+	double det = (a[1] * b[2] - a[2] * b[1]) * c[0] + (a[2] * b[0] - a[0] * b[2]) * c[1]
+			+ (a[0] * b[1] - a[1] * b[0]) * c[2];
+	parity = det > 0.0 ? 1 : 0;
+
+	uint32_t s[3] = { star[0], star[1], star[2] };
+	for (i = 0; i < 3; ++i) star[i] = s[order[i]];
+}
+
+/*!
+ * @brief 生成以一颗星为参考星的三角形
+ * @param stars   星表
+ * @param tree    kd树
+ * @param ref     参考星序号
+ * @param rmax    边长上限, 量纲: 角度
+ * @param cosmin  最长边下限的余弦
+ * @param nb      邻星缓存
+ * @param out     生成的三角形, 未排序
+ */
+static void triangles_of(const StarTable &stars, const KdTree &tree, uint32_t ref, double rmax, double cosmin,
+		vector<uint32_t> &nb, TriangleSet &out) {
+	double cosmax = cos(rmax * D2R);
+	size_t i, j, n;
+	int ntri(0);
+
+	if ((n = ShapeEngine::Neighbours(stars, tree, ref, rmax, nb)) < 2) return;
+	auto cosine = [&stars](uint32_t p, uint32_t q) {
+		return stars.x[p] * stars.x[q] + stars.y[p] * stars.y[q] + stars.z[p] * stars.z[q];
+	};
+
+	// 依亮度顺序取邻星对
+	for (i = 0; i < n && ntri < SHAPE_PER_STAR; ++i) {
+		double cab = cosine(ref, nb[i]);
+		for (j = i + 1; j < n && ntri < SHAPE_PER_STAR; ++j) {
+			double cac = cosine(ref, nb[j]), cbc = cosine(nb[i], nb[j]);
+			if (cbc < cosmax) continue;	// 边长超出上限
+			if (cab > cosmin && cac > cosmin && cbc > cosmin) continue;	// 最长边过短
+
+			uint32_t tri[3] = { ref, nb[i], nb[j] };
+			float code[2];
+			uint8_t parity;
+			TriangleEngine::MakeCode(stars, tri, code, parity);
+			out.code.insert(out.code.end(), code, code + 2);
+			out.parity.push_back(parity);
+			out.star.insert(out.star.end(), tri, tri + 3);
+			++ntri;
+		}
+	}
+}
+
+size_t TriangleEngine::Build(const StarTable &stars, const KdTree &tree, double fov, TriangleSet &tris,
+		int nthread) {
+	steady_clock::time_point t0 = steady_clock::now();
+	uint32_t n = uint32_t(stars.Size());
+	double rmax = fov * SHAPE_MAX_SCALE;
+	double cosmin = cos(fov * SHAPE_MIN_SCALE * D2R);
+	size_t i, k, total(0);
+
+	tris.Clear();
+	if (nthread <= 0) nthread = thread::hardware_concurrency();
+	if (nthread < 1) nthread = 1;
+	vector<TriangleSet> part(nthread);
+	vector<vector<uint32_t> > nbs(nthread);
+
+	run_stealing(n, nthread, TRIANGLE_GRAIN, [&](int t, uint32_t first, uint32_t last) {
+		for (uint32_t j = first; j < last; ++j) triangles_of(stars, tree, j, rmax, cosmin, nbs[t], part[t]);
+	});
+
+	// 合并后按哈希码、星序号排序. 各组星只生成一次, 排序结果与线程数无关
+	TriangleSet all;
+	for (k = 0; k < part.size(); ++k) total += part[k].Size();
+	all.code.reserve(total * 2);
+	all.parity.reserve(total);
+	all.star.reserve(total * 3);
+	for (k = 0; k < part.size(); ++k) {
+		all.code.insert(all.code.end(), part[k].code.begin(), part[k].code.end());
+		all.parity.insert(all.parity.end(), part[k].parity.begin(), part[k].parity.end());
+		all.star.insert(all.star.end(), part[k].star.begin(), part[k].star.end());
+	}
+	vector<uint32_t> order(total);
+	for (i = 0; i < total; ++i) order[i] = uint32_t(i);
+	sort(order.begin(), order.end(), [&all](uint32_t p, uint32_t q) {
+		if (all.code[2 * p] != all.code[2 * q]) return all.code[2 * p] < all.code[2 * q];
+		if (all.code[2 * p + 1] != all.code[2 * q + 1]) return all.code[2 * p + 1] < all.code[2 * q + 1];
+		return lexicographical_compare(&all.star[3 * p], &all.star[3 * p + 3], &all.star[3 * q], &all.star[3 * q + 3]);
+	});
+	tris.code.resize(total * 2);
+	tris.parity.resize(total);
+	tris.star.resize(total * 3);
+	for (i = 0; i < total; ++i) {
+		uint32_t j = order[i];
+		tris.code[2 * i]     = all.code[2 * j];
+		tris.code[2 * i + 1] = all.code[2 * j + 1];
+		tris.parity[i] = all.parity[j];
+		for (k = 0; k < 3; ++k) tris.star[3 * i + k] = all.star[3 * j + k];
+	}
+
+	seconds_ = duration<double>(steady_clock::now() - t0).count();
+	return tris.Size();
+}
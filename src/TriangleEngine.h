@@ -0,0 +1,101 @@
+/**
+ * @file TriangleEngine.h 三角形哈希码生成与检索
+ * @note
+ * - 星形为3颗星(-N 3)时使用. 三边长a >= b >= c, 哈希码为两个边长比(b/a, c/a)与
+ *   定向奇偶性. 边长比与平移、旋转、缩放及镜像无关, 奇偶性区分镜像
+ * - 顶点按其对边由长至短排列: V0对a, V1对b, V2对c. 奇偶性为(V0 x V1)·V2的符号
+ * - 哈希码以单精度存储, 奇偶性以一个字节存储. 每个三角形占用21字节, 四边形占用48字节
+ * - 与ShapeEngine相同, 每颗星作为参考星只与暗于其的邻星构成三角形, 参考星以工作窃取方式
+ *   分配给各线程. 生成的三角形按哈希码排序, 检索时二分查找b/a的范围
+ */
+
+#ifndef TRIANGLEENGINE_H_
+#define TRIANGLEENGINE_H_
+
+#include <stdint.h>
+#include <vector>
+#include "StarTable.h"
+#include "KdTree.h"
+
+/*!
+ * @struct TriangleSet 一组三角形. 按哈希码升序排列
+ */
+struct TriangleSet {
+	std::vector<float> code;		//< 哈希码(b/a, c/a), 每个三角形2个
+	std::vector<uint8_t> parity;	//< 奇偶性: 1: (V0 x V1)·V2 > 0; 0: 其它
+	std::vector<uint32_t> star;		//< 星序号: V0、V1、V2, 每个三角形3个
+
+public:
+	/*!
+	 * @brief 三角形数
+	 */
+	size_t Size() const {
+		return parity.size();
+	}
+	/*!
+	 * @brief 存储量, 量纲: 字节
+	 */
+	size_t Bytes() const {
+		return code.size() * sizeof(float) + parity.size() + star.size() * sizeof(uint32_t);
+	}
+	/*!
+	 * @brief 清除所有三角形
+	 */
+	void Clear() {
+		code.clear();
+		parity.clear();
+		star.clear();
+	}
+	/*!
+	 * @brief 检索哈希码相近的三角形
+	 * @param r1      b/a
+	 * @param r2      c/a
+	 * @param par     奇偶性. -1: 不区分
+	 * @param tol     各维的容差
+	 * @param result  检索结果: 三角形序号, 按哈希码升序排列
+	 * @return
+	 * 检索到的三角形数
+	 */
+	int Lookup(double r1, double r2, int par, double tol, std::vector<uint32_t> &result) const;
+};
+
+class TriangleEngine {
+public:
+	TriangleEngine();
+	virtual ~TriangleEngine();
+
+protected:
+	double seconds_;	//< 最近一次生成的耗时, 量纲: 秒
+
+public:
+	/*!
+	 * @brief 生成一个视场的三角形
+	 * @param stars    均匀化星表. 单位矢量已外推至观测历元
+	 * @param tree     由stars构建的kd树
+	 * @param fov      视场直径, 量纲: 角度
+	 * @param tris     生成的三角形. 星序号为stars中的序号
+	 * @param nthread  线程数. 0: 使用全部硬件线程
+	 * @return
+	 * 三角形数
+	 * @note
+	 * - 邻星的选择与ShapeEngine相同. 最长边介于视场直径的SHAPE_MIN_SCALE与SHAPE_MAX_SCALE倍之间,
+	 *   依亮度顺序取邻星对, 每颗参考星最多SHAPE_PER_STAR个三角形
+	 */
+	size_t Build(const StarTable &stars, const KdTree &tree, double fov, TriangleSet &tris, int nthread = 0);
+	/*!
+	 * @brief 最近一次生成的耗时, 量纲: 秒
+	 */
+	double Seconds() const {
+		return seconds_;
+	}
+	/*!
+	 * @brief 计算三角形的哈希码
+	 * @param stars   星表
+	 * @param star    星序号, 3个. 按对边由长至短重排
+	 * @param code    哈希码(b/a, c/a)
+	 * @param parity  奇偶性
+	 */
+	static void MakeCode(const StarTable &stars, uint32_t *star, float *code, uint8_t &parity);
+};
+
+#endif /* TRIANGLEENGINE_H_ */
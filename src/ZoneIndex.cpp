@@ -0,0 +1,357 @@
+/**
+ * @file ZoneIndex.cpp 分区索引星表文件及锥形检索
+ */
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include "ADefine.h"
+#include "build_index.h"
+#include "StarTable.h"
+#include "sphere_kernel.h"
+#include "ZoneIndex.h"
+
+using namespace std;
+using namespace AstroUtil;
+
+/*!
+ * @struct ZoneIndexHeader 索引文件头
+ */
+struct ZoneIndexHeader {
+	char magic[8];		//< 文件标志
+	uint32_t version;	//< 格式版本
+	int32_t scheme;		//< 分区方案
+	int64_t nside;		//< HEALPix的Nside
+	uint64_t ncell;		//< 分区数
+	uint64_t count;		//< 星数
+	double epoch;		//< 观测历元
+	double pmmax;		//< 最大自行, 量纲: 毫角秒/年
+	uint64_t checksum;	//< 星表校验和, 见StarTable::Checksum()
+	uint64_t offset[9];	//< 分区索引与各列在文件中的起始位置
+};
+
+#define ZONE_INDEX_MAGIC	"TYC2ZIX"
+#define ZONE_INDEX_VERSION	4
+#define ZONE_INDEX_ALIGN	64
+
+/*!
+ * @brief 写入一列, 并在其后补零至对齐位置
+ * @param fp      文件
+ * @param data    数据
+ * @param size    数据长度, 量纲: 字节
+ * @param offset  当前写入位置. 写入后更新
+ * @return
+ * 写入结果
+ */
+static bool write_aligned(FILE *fp, const void *data, size_t size, uint64_t &offset) {
+	static const char zeros[ZONE_INDEX_ALIGN] = { 0 };
+	size_t npad = (ZONE_INDEX_ALIGN - (offset + size) % ZONE_INDEX_ALIGN) % ZONE_INDEX_ALIGN;
+	if (size && fwrite(data, 1, size, fp) != size) return false;
+	if (npad && fwrite(zeros, 1, npad, fp) != npad) return false;
+	offset += size + npad;
+	return true;
+}
+
+ZoneIndex::ZoneIndex() {
+	scheme_ = SKY_GRID;
+	ncell_ = count_ = 0;
+	index_ = NULL;
+	ra = spd = NULL;
+	pmra = pmdc = mag = NULL;
+	x = y = z = NULL;
+	pmmax_ = 0.0;
+	checksum_ = 0;
+	reset_epoch();
+}
+
+ZoneIndex::~ZoneIndex() {
+}
+
+bool ZoneIndex::Save(const char *filepath, const StarTable &table, int scheme, int nside, double epoch) {
+	char tmppath[260];
+	ZoneIndexHeader header;
+	HEALPix hp;
+	size_t i, n = table.Size();
+	uint64_t ncell;
+	uint32_t ra_off, spd_off;
+	int64_t cell, last(-1), pm2, pm2max(0);
+
+	if (healpix_scheme(scheme)) {
+		if (!hp.SetNside(nside)) {
+			printf ("invalid Nside: %d\n", nside);
+			return false;
+		}
+		ncell = hp.Npix();
+	}
+	else ncell = GRID_NDEC * GRID_NRA;
+
+	vector<quick_index> index(ncell);
+	memset(index.data(), 0, sizeof(quick_index) * ncell);
+	for (i = 0; i < n; ++i) {
+		if (healpix_scheme(scheme)) cell = hp.Vec2Pix(table.x[i], table.y[i], table.z[i]);
+		else cell = grid_cell(table.ra[i], table.spd[i], ra_off, spd_off);
+		if (cell != last && index[cell].count) {// 同一分区的星须连续存储
+			printf ("catalog is not sorted by zone\n");
+			return false;
+		}
+		if (cell != last) index[cell].head = uint32_t(i);
+		++index[cell].count;
+		last = cell;
+		pm2 = int64_t(table.pmra[i]) * table.pmra[i] + int64_t(table.pmdc[i]) * table.pmdc[i];
+		if (pm2 > pm2max) pm2max = pm2;
+	}
+	for (i = 1; i < ncell; ++i) {// 空分区的首颗星指向下一分区
+		if (!index[i].count) index[i].head = index[i - 1].head + index[i - 1].count;
+	}
+
+	memset(&header, 0, sizeof(ZoneIndexHeader));
+	memcpy(header.magic, ZONE_INDEX_MAGIC, sizeof(ZONE_INDEX_MAGIC));
+	header.version = ZONE_INDEX_VERSION;
+	header.scheme  = scheme;
+	header.nside   = healpix_scheme(scheme) ? nside : 0;
+	header.ncell   = ncell;
+	header.count   = n;
+	header.epoch   = epoch;
+	header.pmmax   = sqrt(double(pm2max));
+	header.checksum = table.Checksum();
+	size_t sizes[9] = {
+		sizeof(quick_index) * ncell,
+		sizeof(int32_t) * n, sizeof(int32_t) * n,
+		sizeof(int16_t) * n, sizeof(int16_t) * n, sizeof(int16_t) * n,
+		sizeof(double) * n, sizeof(double) * n, sizeof(double) * n
+	};
+	const void *data[9] = {
+		index.data(), table.ra.data(), table.spd.data(), table.pmra.data(), table.pmdc.data(),
+		table.mag.data(), table.x.data(), table.y.data(), table.z.data()
+	};
+	uint64_t offset = (sizeof(ZoneIndexHeader) + ZONE_INDEX_ALIGN - 1) / ZONE_INDEX_ALIGN * ZONE_INDEX_ALIGN;
+	for (i = 0; i < 9; ++i) {
+		header.offset[i] = offset;
+		offset += (sizes[i] + ZONE_INDEX_ALIGN - 1) / ZONE_INDEX_ALIGN * ZONE_INDEX_ALIGN;
+	}
+
+	FILE *fp;
+	sprintf (tmppath, "%s.tmp", filepath);
+	if ((fp = fopen(tmppath, "wb")) == NULL) {
+		printf ("failed to create %s\n", tmppath);
+		return false;
+	}
+	offset = 0;
+	bool rslt = write_aligned(fp, &header, sizeof(ZoneIndexHeader), offset);
+	for (i = 0; i < 9 && rslt; ++i) rslt = write_aligned(fp, data[i], sizes[i], offset);
+	rslt = !fclose(fp) && rslt && !rename(tmppath, filepath);
+	if (!rslt) {
+		printf ("failed to write %s\n", filepath);
+		remove(tmppath);
+	}
+	return rslt;
+}
+
+bool ZoneIndex::Load(const char *filepath) {
+	mf_.Unmap();
+	index_ = NULL;
+	count_ = 0;
+	checksum_ = 0;
+	reset_epoch();
+	if (!mf_.Map(filepath, false) || mf_.size < sizeof(ZoneIndexHeader)) return false;
+
+	const ZoneIndexHeader *hdr = (const ZoneIndexHeader*) mf_.data;
+	uint64_t n = hdr->count;
+	uint64_t sizes[9] = {
+		sizeof(quick_index) * hdr->ncell,
+		sizeof(int32_t) * n, sizeof(int32_t) * n,
+		sizeof(int16_t) * n, sizeof(int16_t) * n, sizeof(int16_t) * n,
+		sizeof(double) * n, sizeof(double) * n, sizeof(double) * n
+	};
+	// 星数与分区数受文件长度限制, 各段长度的计算不溢出
+	bool valid = !memcmp(hdr->magic, ZONE_INDEX_MAGIC, sizeof(ZONE_INDEX_MAGIC))
+			&& hdr->version == ZONE_INDEX_VERSION && hdr->pmmax >= 0.0 && n <= mf_.size && hdr->ncell <= mf_.size;
+	if (valid) {
+		if (healpix_scheme(hdr->scheme)) valid = hp_.SetNside(hdr->nside) && uint64_t(hp_.Npix()) == hdr->ncell;
+		else valid = hdr->scheme == SKY_GRID && hdr->ncell == GRID_NDEC * GRID_NRA;
+	}
+	for (int i = 0; i < 9 && valid; ++i) {
+		valid = hdr->offset[i] % ZONE_INDEX_ALIGN == 0 && hdr->offset[i] <= mf_.size
+				&& sizes[i] <= mf_.size - hdr->offset[i];
+	}
+	// 各分区的星须位于星表范围内
+	const quick_index *qi = valid ? (const quick_index*) (mf_.data + hdr->offset[0]) : NULL;
+	for (uint64_t cell = 0; valid && cell < hdr->ncell; ++cell) {
+		valid = uint64_t(qi[cell].head) + qi[cell].count <= n;
+	}
+	if (!valid) {
+		printf ("%s is not a valid zone index file\n", filepath);
+		mf_.Unmap();
+		return false;
+	}
+
+	scheme_ = hdr->scheme;
+	ncell_  = hdr->ncell;
+	levels_.clear();
+	maxrad_.clear();
+	if (healpix_scheme(scheme_)) {
+		for (int level = 0; level <= hp_.Order(); ++level) {
+			levels_.push_back(HEALPix(int64_t(1) << level));
+			maxrad_.push_back(levels_.back().MaxPixelRadius());
+		}
+	}
+	count_  = n;
+	index_  = (const quick_index*) (mf_.data + hdr->offset[0]);
+	ra   = (const int32_t*) (mf_.data + hdr->offset[1]);
+	spd  = (const int32_t*) (mf_.data + hdr->offset[2]);
+	pmra = (const int16_t*) (mf_.data + hdr->offset[3]);
+	pmdc = (const int16_t*) (mf_.data + hdr->offset[4]);
+	mag  = (const int16_t*) (mf_.data + hdr->offset[5]);
+	x    = (const double*)  (mf_.data + hdr->offset[6]);
+	y    = (const double*)  (mf_.data + hdr->offset[7]);
+	z    = (const double*)  (mf_.data + hdr->offset[8]);
+	pmmax_ = hdr->pmmax;
+	checksum_ = hdr->checksum;
+	SetEpoch(hdr->epoch);
+	return true;
+}
+
+void ZoneIndex::reset_epoch() {
+	epoch_ = CATALOG_EPOCH;
+	years_ = 0.0;
+	stamp_ = 0;
+	propagated_ = 0;
+	cellstamp_.clear();
+	ex_.clear();
+	ey_.clear();
+	ez_.clear();
+}
+
+void ZoneIndex::SetEpoch(double epoch) {
+	if (epoch == epoch_) return;
+	epoch_ = epoch;
+	years_ = epoch - CATALOG_EPOCH;
+	propagated_ = 0;
+	if (years_ == 0.0 || !index_) return;
+	if (cellstamp_.size() != ncell_) {// 首次使用时分配缓存
+		cellstamp_.assign(ncell_, 0);
+		ex_.resize(count_);
+		ey_.resize(count_);
+		ez_.resize(count_);
+		stamp_ = 0;
+	}
+	if (++stamp_ == 0) {// 标记回绕
+		cellstamp_.assign(ncell_, 0);
+		stamp_ = 1;
+	}
+}
+
+void ZoneIndex::Vector(size_t i, double v[3]) const {
+	if (years_ == 0.0) {
+		v[0] = x[i];
+		v[1] = y[i];
+		v[2] = z[i];
+	}
+	else propagate_vectors(x + i, y + i, z + i, pmra + i, pmdc + i, 1, years_, v, v + 1, v + 2);
+}
+
+CatStar ZoneIndex::At(size_t i) const {
+	CatStar star;
+	star.ra   = ra[i];
+	star.spd  = spd[i];
+	star.pmra = pmra[i];
+	star.pmdc = pmdc[i];
+	star.mag  = mag[i];
+	return star;
+}
+
+int ZoneIndex::ConeSearch(double ra0, double dec0, double radius, double maglim, vector<uint32_t> &result) const {
+	result.clear();
+	if (!index_) return 0;
+
+	double center[3];
+	unit_vector(cyclemod(ra0, 360.0), dec0, center);
+	double cosr = cos(radius * D2R);
+	int mlim = maglim * 1000.0 < SHRT_MAX ? int(floor(maglim * 1000.0 + 0.5)) : SHRT_MAX;
+	double pad = pmmax_ * fabs(years_) * MAS2D;	// 自行引起的最大位移, 量纲: 角度
+
+	if (healpix_scheme(scheme_)) search_healpix(radius + pad, center, cosr, mlim, result);
+	else search_grid(cyclemod(ra0, 360.0), dec0, radius + pad, center, cosr, mlim, result);
+	return int(result.size());
+}
+
+void ZoneIndex::propagate_cell(int64_t cell) const {
+	const quick_index &qi = index_[cell];
+	if (cellstamp_[cell] == stamp_) return;
+	propagate_vectors(x + qi.head, y + qi.head, z + qi.head, pmra + qi.head, pmdc + qi.head, qi.count, years_,
+			ex_.data() + qi.head, ey_.data() + qi.head, ez_.data() + qi.head);
+	cellstamp_[cell] = stamp_;
+	propagated_ += qi.count;
+}
+
+void ZoneIndex::search_cell(int64_t cell, const double center[3], double cosr, int maglim,
+		vector<uint32_t> &result) const {
+	const quick_index &qi = index_[cell];
+	const int16_t *m = maglim < SHRT_MAX ? mag : NULL;
+	if (years_ == 0.0) select_in_cone(x, y, z, m, qi.head, qi.count, center, cosr, maglim, result);
+	else {
+		propagate_cell(cell);
+		select_in_cone(ex_.data(), ey_.data(), ez_.data(), m, qi.head, qi.count, center, cosr, maglim, result);
+	}
+}
+
+void ZoneIndex::search_grid(double ra0, double dec0, double radius, const double center[3], double cosr,
+		int maglim, vector<uint32_t> &result) const {
+	const double width = GRID_WIDTH * MAS2D;	// 分区宽度, 量纲: 角度
+	const double margin = 1E-9;	// 分区边界的舍入误差余量, 量纲: 角度
+	double dmin = dec0 - radius - margin;
+	double dmax = dec0 + radius + margin;
+	bool allra = dmin <= -90.0 || dmax >= 90.0;	// 包含天极
+	int id, id0, id1, ir0(0), ir1(GRID_NRA - 1), k;
+
+	id0 = allra && dmin <= -90.0 ? 0 : int((dmin + 90.0) / width);
+	id1 = allra && dmax >= 90.0 ? GRID_NDEC - 1 : int((dmax + 90.0) / width);
+	if (id0 < 0) id0 = 0;
+	if (id1 >= GRID_NDEC) id1 = GRID_NDEC - 1;
+	if (!allra) {
+		double s = sin(radius * D2R) / cos(dec0 * D2R);
+		if (s >= 1.0) allra = true;
+		else {
+			double dra = asin(s) * R2D + margin;	// 赤经半宽
+			ir0 = int(floor((ra0 - dra) / width));
+			ir1 = int(floor((ra0 + dra) / width));
+			if (ir1 - ir0 + 1 >= GRID_NRA) allra = true;
+		}
+	}
+	if (allra) {
+		ir0 = 0;
+		ir1 = GRID_NRA - 1;
+	}
+
+	for (id = id0; id <= id1; ++id) {
+		for (k = ir0; k <= ir1; ++k) {// 赤经回绕
+			int ir = k < 0 ? k + GRID_NRA : (k >= GRID_NRA ? k - GRID_NRA : k);
+			search_cell(id * GRID_NRA + ir, center, cosr, maglim, result);
+		}
+	}
+}
+
+void ZoneIndex::search_healpix(double radius, const double center[3], double cosr, int maglim,
+		vector<uint32_t> &result) const {
+	int order = hp_.Order(), level;
+	double cosmax[HEALPix::MAX_ORDER + 1];	// 各阶像元中心与锥形中心的最大角距的余弦
+	double px, py, pz;
+	int64_t pix;
+	vector<int64_t> stack;	// 待判定像元: (序号 << 5) | 阶数
+
+	for (level = 0; level <= order; ++level) {
+		double rmax = radius * D2R + maxrad_[level];
+		cosmax[level] = rmax < API ? cos(rmax) : -1.0;
+	}
+	for (pix = 11; pix >= 0; --pix) stack.push_back(pix << 5);
+	while (stack.size()) {
+		pix   = stack.back() >> 5;
+		level = int(stack.back() & 31);
+		stack.pop_back();
+		levels_[level].Pix2Vec(pix, px, py, pz);
+		if (px * center[0] + py * center[1] + pz * center[2] < cosmax[level]) continue;
+		if (level == order) search_cell(pix, center, cosr, maglim, result);
+		else {// 子像元按序号升序出栈
+			for (int k = 3; k >= 0; --k) stack.push_back((((pix << 2) + k) << 5) | (level + 1));
+		}
+	}
+}
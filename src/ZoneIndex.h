@@ -0,0 +1,212 @@
+/**
+ * @file ZoneIndex.h 分区索引星表文件及锥形检索
+ * @note
+ * 文件结构:
+ * - 文件头
+ * - 分区索引: quick_index[分区数], 各分区的星在星表中连续存储
+ * - 星表各列: ra、spd、pmra、pmdc、mag、x、y、z. 每列起始位置按64字节对齐
+ * @note
+ * 分区方案:
+ * - SKY_GRID: 赤纬72带 x 赤经144区, 每区2.5度x2.5度. 分区序号 = 赤纬带 * 144 + 赤经区
+ * - SKY_HEALPIX, SKY_HILBERT: HEALPix NESTED像元, 分区序号即像元序号. 两者只是星的排列
+ *   顺序不同, 分区索引记录各分区的起始位置, 不要求分区按序号排列
+ * @note
+ * 观测历元:
+ * - 文件中的坐标与单位矢量始终为J2000, 文件头记录生成索引时指定的观测历元, 作为检索历元的初值,
+ *   及全表的最大自行, 加载时无需扫描自行列
+ * - 检索历元不是J2000时, 检索访问的分区在首次访问时由自行外推单位矢量并缓存.
+ *   同一历元的后续检索直接使用缓存, 改变历元后各分区重新外推
+ */
+
+#ifndef ZONEINDEX_H_
+#define ZONEINDEX_H_
+
+#include <stdint.h>
+#include <vector>
+#include "HEALPix.h"
+#include "MappedFile.hpp"
+#include "build_index.h"
+
+class StarTable;
+
+#define GRID_WIDTH	9000000	//< 赤经赤纬分区宽度: 2.5度, 量纲: 毫角秒
+#define GRID_NDEC	72		//< 赤纬带数
+#define GRID_NRA	144		//< 每个赤纬带的赤经分区数
+
+/*!
+ * @brief 计算赤经赤纬分区
+ * @param ra       赤经, 量纲: 毫角秒
+ * @param spd      极距(赤纬+90度), 量纲: 毫角秒
+ * @param ra_off   分区内赤经偏移, 量纲: 毫角秒
+ * @param spd_off  分区内极距偏移, 量纲: 毫角秒
+ * @return
+ * 分区序号
+ * @note
+ * - 赤经=360度或极距=180度的星归入最后一区
+ */
+inline int grid_cell(int32_t ra, int32_t spd, uint32_t &ra_off, uint32_t &spd_off) {
+	uint32_t r = ra < 0 ? 0 : uint32_t(ra);
+	uint32_t d = spd < 0 ? 0 : uint32_t(spd);
+	uint32_t ir = r / GRID_WIDTH, id = d / GRID_WIDTH;
+	if (ir >= GRID_NRA)  ir = GRID_NRA - 1;
+	if (id >= GRID_NDEC) id = GRID_NDEC - 1;
+	ra_off  = r - ir * GRID_WIDTH;
+	spd_off = d - id * GRID_WIDTH;
+	return int(id * GRID_NRA + ir);
+}
+
+/*!
+ * @struct quick_index 分区索引
+ */
+struct quick_index {
+	uint32_t head;	//< 首颗星的序号
+	uint32_t count;	//< 星数
+};
+
+class ZoneIndex {
+public:
+	ZoneIndex();
+	virtual ~ZoneIndex();
+
+protected:
+	MappedFile mf_;		//< 内存映射的索引文件
+	int scheme_;		//< 分区方案
+	HEALPix hp_;		//< HEALPix划分
+	std::vector<HEALPix> levels_;	//< 0阶至hp_各阶的HEALPix划分
+	std::vector<double> maxrad_;	//< 各阶像元的最大半径, 量纲: 弧度
+	uint64_t ncell_;	//< 分区数
+	uint64_t count_;	//< 星数
+	const quick_index *index_;	//< 分区索引
+	double epoch_;		//< 检索历元
+	double years_;		//< 检索历元与J2000之差, 量纲: 年
+	double pmmax_;		//< 最大自行, 量纲: 毫角秒/年
+	uint64_t checksum_;	//< 星表校验和
+	uint32_t stamp_;	//< 当前检索历元的标记. 每次改变历元时递增
+	mutable std::vector<uint32_t> cellstamp_;	//< 各分区已外推的历元标记
+	mutable std::vector<double> ex_, ey_, ez_;	//< 外推至检索历元的单位矢量
+	mutable size_t propagated_;	//< 当前检索历元已外推的星数
+
+public:
+	/* 星表各列. 各列定义同StarTable */
+	const int32_t *ra, *spd;
+	const int16_t *pmra, *pmdc;
+	const int16_t *mag;
+	const double *x, *y, *z;
+
+public:
+	/*!
+	 * @brief 将已排序的星表存储为索引文件
+	 * @param filepath  文件路径
+	 * @param table     星表. 已由sort_catalog()按相同分区方案排序, 同一分区的星连续
+	 * @param scheme    分区方案
+	 * @param nside     HEALPix的Nside. 仅用于SKY_HEALPIX与SKY_HILBERT
+	 * @param epoch     观测历元, 作为加载后检索历元的初值. 量纲: 年
+	 * @return
+	 * 存储结果
+	 */
+	static bool Save(const char *filepath, const StarTable &table, int scheme, int nside = 0,
+			double epoch = CATALOG_EPOCH);
+	/*!
+	 * @brief 内存映射索引文件
+	 * @param filepath  文件路径
+	 * @return
+	 * 文件是否有效
+	 */
+	bool Load(const char *filepath);
+	/*!
+	 * @brief 星数
+	 */
+	size_t Size() const {
+		return count_;
+	}
+	/*!
+	 * @brief 分区方案
+	 */
+	int Scheme() const {
+		return scheme_;
+	}
+	/*!
+	 * @brief 以行记录形式取出一颗星
+	 * @param i  序号
+	 */
+	CatStar At(size_t i) const;
+	/*!
+	 * @brief 设置检索历元
+	 * @param epoch  观测历元, 量纲: 年
+	 * @note
+	 * - 与当前检索历元相同时保留已外推的分区
+	 * - 检索历元不是J2000时, ConeSearch()改写外推缓存, 不可由多个线程同时调用
+	 */
+	void SetEpoch(double epoch);
+	/*!
+	 * @brief 存储时星表的校验和, 见StarTable::Checksum()
+	 */
+	uint64_t Checksum() const {
+		return checksum_;
+	}
+	/*!
+	 * @brief 检索历元
+	 */
+	double Epoch() const {
+		return epoch_;
+	}
+	/*!
+	 * @brief 当前检索历元已外推的星数
+	 */
+	size_t Propagated() const {
+		return propagated_;
+	}
+	/*!
+	 * @brief 取一颗星在检索历元的单位矢量
+	 * @param i  序号
+	 * @param v  单位矢量
+	 */
+	void Vector(size_t i, double v[3]) const;
+	/*!
+	 * @brief 锥形检索
+	 * @param ra      中心赤经, 量纲: 角度
+	 * @param dec     中心赤纬, 量纲: 角度
+	 * @param radius  半径, 量纲: 角度
+	 * @param maglim  极限星等
+	 * @param result  检索结果: 星序号. SKY_HEALPIX时升序; SKY_HILBERT时不保证顺序;
+	 *                SKY_GRID跨越赤经0点时不保证顺序
+	 * @return
+	 * 检索到的星数
+	 * @note
+	 * - 只访问与锥形区域重叠的分区, 再以单位矢量的点积判定是否在区域内
+	 * - 检索历元不是J2000时, 以最大自行在历元差内的位移扩大分区的选择范围,
+	 *   以外推后的单位矢量判定
+	 * - SKY_GRID: 锥形区域包含天极时检索相关赤纬带的所有分区; 否则依据赤经半宽
+	 *   asin(sin(radius) / cos(dec))确定赤经分区, 跨越赤经0点时回绕
+	 * - SKY_HEALPIX, SKY_HILBERT: 由12个基础像元逐阶细分至索引的Nside. 像元中心与锥形中心的
+	 *   角距不大于radius + 该阶像元最大半径时, 像元可能与区域重叠, 继续细分其4个子像元
+	 */
+	int ConeSearch(double ra, double dec, double radius, double maglim, std::vector<uint32_t> &result) const;
+
+protected:
+	/*!
+	 * @brief 清除外推缓存
+	 */
+	void reset_epoch();
+	/*!
+	 * @brief 将一个分区外推至检索历元. 已外推的分区不重复计算
+	 */
+	void propagate_cell(int64_t cell) const;
+	/*!
+	 * @brief 在一个分区中查找锥形区域内的星
+	 */
+	void search_cell(int64_t cell, const double center[3], double cosr, int maglim,
+			std::vector<uint32_t> &result) const;
+	/*!
+	 * @brief 赤经赤纬分区的锥形检索
+	 */
+	void search_grid(double ra, double dec, double radius, const double center[3], double cosr, int maglim,
+			std::vector<uint32_t> &result) const;
+	/*!
+	 * @brief HEALPix分区的锥形检索
+	 */
+	void search_healpix(double radius, const double center[3], double cosr, int maglim,
+			std::vector<uint32_t> &result) const;
+};
+
+#endif /* ZONEINDEX_H_ */
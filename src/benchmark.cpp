@@ -0,0 +1,1150 @@
+/**
+ * @file benchmark.cpp 性能测试
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include <boost/algorithm/string/trim.hpp>
+#include "ADefine.h"
+#include "build_index.h"
+#include "field_decode.h"
+#include "StarTable.h"
+#include "sphere_kernel.h"
+#include "ZoneIndex.h"
+#include "KdTree.h"
+#include "uniformize.h"
+#include "ShapeEngine.h"
+#include "TriangleEngine.h"
+#include "FixedShapeEngine.hpp"
+#include "CodeTree.h"
+#include "benchmark.h"
+
+using namespace std;
+using namespace std::chrono;
+using namespace AstroUtil;
+using namespace boost::algorithm;
+
+/*!
+ * @brief 原解析算法, 作为性能和结果一致性的参照
+ */
+static bool resolve_cat_legacy(const string &line, CatStar &star) {
+	string ra_str, dc_str, pmra_str, pmdc_str, bt_str, vt_str;
+
+	if (line[13] == ' ') {
+		ra_str   = line.substr(15, 12); trim(ra_str);
+		dc_str   = line.substr(28, 12); trim(dc_str);
+	}
+	else {
+		ra_str   = line.substr(152, 12); trim(ra_str);
+		dc_str   = line.substr(165, 12); trim(dc_str);
+	}
+	pmra_str = line.substr(41, 7);  trim(pmra_str);
+	pmdc_str = line.substr(49, 7);  trim(pmdc_str);
+	bt_str   = line.substr(110, 6); trim(bt_str);
+	vt_str   = line.substr(123, 6); trim(vt_str);
+	star.ra  = int(stod(ra_str) * D2MAS);
+	star.spd = int((stod(dc_str) + 90.0) * D2MAS);
+	if (pmra_str.size()) star.pmra = short(stod(pmra_str));
+	if (pmdc_str.size()) star.pmdc = short(stod(pmdc_str));
+	if (bt_str.size() || vt_str.size()) {
+		if (bt_str.size() && vt_str.size()) {
+			double vt = stod(vt_str);
+			star.mag = short((vt - 0.09 * (stod(bt_str) - vt)) * 1000.0);
+		}
+		else {
+			star.mag = short((bt_str.size() ? stod(bt_str) : stod(vt_str)) * 1000.0);
+		}
+		return true;
+	}
+	return false;
+}
+
+/*!
+ * @brief 读取tyc2.dat.xx全部行
+ */
+static void read_lines(const char *pathroot, vector<string> &lines) {
+	const int szline(220);
+	char filepath[256], line[szline];
+
+	for (int i = 0; i < 20; ++i) {
+		sprintf (filepath, "%s/tyc2.dat.%02d", pathroot, i);
+		FILE *fp = fopen(filepath, "r");
+		if (fp == NULL) continue;
+		while (fgets(line, szline, fp)) lines.push_back(line);
+		fclose(fp);
+	}
+}
+
+/*!
+ * @brief 分批调用decode_records()解码全部行
+ */
+static double decode_batches(const vector<string> &lines, CatStarVec &stars, vector<char> &ok) {
+	const int szbatch(256);
+	const char *ptr[szbatch];
+	int lens[szbatch];
+	char status[szbatch];
+	size_t n = lines.size(), i, j, k;
+
+	steady_clock::time_point t0 = steady_clock::now();
+	for (i = 0; i < n; i += szbatch) {
+		k = min(n - i, size_t(szbatch));
+		for (j = 0; j < k; ++j) {
+			ptr[j]  = lines[i + j].data();
+			lens[j] = int(lines[i + j].size());
+		}
+		decode_records(false, ptr, lens, int(k), INT_MAX, &stars[i], status);
+		for (j = 0; j < k; ++j) ok[i + j] = status[j] == RESOLVE_OK;
+	}
+	return duration<double>(steady_clock::now() - t0).count();
+}
+
+/*!
+ * @brief 统计与参照结果不一致的记录数
+ */
+static size_t count_mismatch(const CatStarVec &ref, const vector<char> &okref,
+		const CatStarVec &stars, const vector<char> &ok) {
+	size_t nmis(0);
+	for (size_t i = 0; i < ref.size(); ++i) {
+		if (okref[i] != ok[i] || (ok[i] && memcmp(&ref[i], &stars[i], sizeof(CatStar)))) ++nmis;
+	}
+	return nmis;
+}
+
+int bench_parser(const char *pathroot) {
+	vector<string> lines;
+	size_t i, n, nmis;
+
+	read_lines(pathroot, lines);
+	if (!(n = lines.size())) {
+		printf ("no record found in %s\n", pathroot);
+		return -1;
+	}
+	CatStarVec legacy(n), fixed(n), scalar(n), simd(n);
+	vector<char> ok1(n), ok2(n), ok3(n), ok4(n);
+
+	steady_clock::time_point t0 = steady_clock::now();
+	for (i = 0; i < n; ++i) ok1[i] = resolve_cat_legacy(lines[i], legacy[i]);
+	steady_clock::time_point t1 = steady_clock::now();
+	for (i = 0; i < n; ++i) ok2[i] = resolve_cat(lines[i].data(), lines[i].size(), fixed[i]);
+	steady_clock::time_point t2 = steady_clock::now();
+	enable_simd_decoder(false);
+	double dt3 = decode_batches(lines, scalar, ok3);
+	enable_simd_decoder(true);
+	double dt4 = decode_batches(lines, simd, ok4);
+
+	double dt1 = duration<double>(t1 - t0).count();
+	double dt2 = duration<double>(t2 - t1).count();
+	printf ("%zu lines\n", n);
+	printf ("substr/trim/stod : %8.3f sec, %12.0f lines/sec\n", dt1, n / dt1);
+	printf ("fixed column     : %8.3f sec, %12.0f lines/sec\n", dt2, n / dt2);
+	printf ("batch, scalar    : %8.3f sec, %12.0f lines/sec\n", dt3, n / dt3);
+	printf ("batch, %-6s    : %8.3f sec, %12.0f lines/sec\n", decoder_name(), dt4, n / dt4);
+	nmis = count_mismatch(legacy, ok1, fixed, ok2)
+			+ count_mismatch(legacy, ok1, scalar, ok3)
+			+ count_mismatch(legacy, ok1, simd, ok4);
+	printf ("%zu mismatched records\n", nmis);
+	return int(nmis);
+}
+
+int bench_epoch(int n) {
+	ATimeSpace ats;
+	vector<double> ra(n), dc(n), ra1(n), dc1(n), ra2(n), dc2(n);
+	double err, errmax(0.0);
+	int i;
+
+	ats.SetEpoch(1991.25);
+	srand(1);
+	for (i = 0; i < n; ++i) {
+		ra[i] = rand() / (RAND_MAX + 1.0) * A2PI;
+		dc[i] = asin(rand() / (RAND_MAX + 1.0) * 2.0 - 1.0);
+	}
+
+	steady_clock::time_point t0 = steady_clock::now();
+	for (i = 0; i < n; ++i) ats.EqReTransfer(ra[i], dc[i], ra1[i], dc1[i]);
+	steady_clock::time_point t1 = steady_clock::now();
+	ats.EqReTransfer(n, ra.data(), dc.data(), ra2.data(), dc2.data());
+	steady_clock::time_point t2 = steady_clock::now();
+
+	for (i = 0; i < n; ++i) {
+		double dr = remainder(ra1[i] - ra2[i], A2PI) * cos(dc1[i]);
+		double dd = dc1[i] - dc2[i];
+		if ((err = sqrt(dr * dr + dd * dd) * R2AS * 1000.0) > errmax) errmax = err;
+	}
+	double dt1 = duration<double>(t1 - t0).count();
+	double dt2 = duration<double>(t2 - t1).count();
+	printf ("%d positions\n", n);
+	printf ("per position : %8.3f sec, %12.0f positions/sec\n", dt1, n / dt1);
+	printf ("batch        : %8.3f sec, %12.0f positions/sec\n", dt2, n / dt2);
+	printf ("maximum difference: %.6f mas\n", errmax);
+	return errmax < 0.1 ? 0 : -1;
+}
+
+/*!
+ * @brief 以各排序算法排序星表, 显示耗时并检查结果的一致性
+ * @param table  星表
+ * @return
+ * 排序结果是否一致
+ */
+static bool compare_sorts(const StarTable &table) {
+	const char *names[] = { "merge sort, 1 thread", "merge sort", "radix sort, 1 thread", "radix sort" };
+	const int method[] = { SORT_MERGE, SORT_MERGE, SORT_RADIX, SORT_RADIX };
+	const int nthread[] = { 1, 0, 1, 0 };
+	StarTable ref;
+	bool same(true);
+	size_t i, n = table.Size();
+
+	printf ("%zu stars, %u threads\n", n, thread::hardware_concurrency());
+	// 基准: 原实现以浮点分区号比较行记录的std::sort. 分区内顺序未定义, 不参与一致性比较
+	vector<CatStar> rows(n);
+	for (i = 0; i < n; ++i) rows[i] = table.At(i);
+	steady_clock::time_point t0 = steady_clock::now();
+	sort(rows.begin(), rows.end(), [](const CatStar& x1, const CatStar& x2) {
+		double scale = 0.4 * MAS2D;
+		int id1 = int(x1.spd * scale);
+		int id2 = int(x2.spd * scale);
+		int ir1 = int(x1.ra * scale);
+		int ir2 = int(x2.ra * scale);
+		return (id1 < id2 || (id1 == id2 && ir1 < ir2));
+	});
+	double dt = duration<double>(steady_clock::now() - t0).count();
+	printf ("%-20s : %8.3f sec, %12.0f stars/sec\n", "std::sort, legacy", dt, n / dt);
+
+	for (i = 0; i < 4; ++i) {
+		StarTable sorted(table);
+		steady_clock::time_point t0 = steady_clock::now();
+		sort_catalog(sorted, nthread[i], method[i]);
+		double dt = duration<double>(steady_clock::now() - t0).count();
+		printf ("%-20s : %8.3f sec, %12.0f stars/sec\n", names[i], dt, n / dt);
+		if (!i) ref.Swap(sorted);
+		else if (sorted.ra != ref.ra || sorted.spd != ref.spd || sorted.mag != ref.mag) same = false;
+	}
+	return same;
+}
+
+/*!
+ * @brief 合成星表: 每颗星复制为scale颗, 赤经、赤纬随机偏移至多1度
+ */
+static void synth_catalog(const StarTable &table, int scale, StarTable &synth) {
+	size_t i, n = table.Size();
+	int j;
+
+	synth.Clear();
+	synth.Reserve(n * scale);
+	srand(1);
+	for (i = 0; i < n; ++i) {
+		CatStar star = table.At(i);
+		for (j = 0; j < scale; ++j) {
+			CatStar x(star);
+			x.ra  = int(cyclemod(star.ra + (rand() / (RAND_MAX + 1.0) * 2.0 - 1.0) * D2MAS, 360.0 * D2MAS));
+			x.spd = int(star.spd + (rand() / (RAND_MAX + 1.0) * 2.0 - 1.0) * D2MAS);
+			if (x.spd < 0) x.spd = 0;
+			else if (x.spd > 180.0 * D2MAS) x.spd = int(180.0 * D2MAS);
+			synth.Append(x);
+		}
+	}
+	synth.UpdateVectors();
+}
+
+int bench_sort(const char *pathroot) {
+	const int scale(10);
+	StarTable table, synth;
+
+	load_catalog(table, pathroot);
+	if (!table.Size()) {
+		printf ("no record found in %s\n", pathroot);
+		return -1;
+	}
+	bool same = compare_sorts(table);
+	synth_catalog(table, scale, synth);
+	same = compare_sorts(synth) && same;
+	printf ("sorted catalogs are %s\n", same ? "identical" : "different");
+	return same ? 0 : -1;
+}
+
+/*!
+ * @brief 逐星比对的锥形检索
+ */
+static void cone_brute(const ZoneIndex &zi, double ra, double dec, double radius, vector<uint32_t> &result) {
+	double center[3], cosr = cos(radius * D2R);
+
+	unit_vector(ra, dec, center);
+	result.clear();
+	for (size_t i = 0; i < zi.Size(); ++i) {
+		if (zi.x[i] * center[0] + zi.y[i] * center[1] + zi.z[i] * center[2] >= cosr) result.push_back(uint32_t(i));
+	}
+}
+
+int bench_cone(const char *pathroot, int nside) {
+	const int ncone(10000), ncheck(200);
+	const char *names[] = { "RA/Dec grid", "HEALPix" };
+	const int schemes[] = { SKY_GRID, SKY_HEALPIX };
+	char filepath[256];
+	StarTable table;
+	vector<double> ra(ncone), dec(ncone), radius(ncone);
+	vector<uint32_t> result, expect;
+	size_t nfound;
+	int i, j, nmis(0);
+
+	if (!load_cache(table, pathroot, 99.0)) load_catalog(table, pathroot);
+	if (!table.Size()) {
+		printf ("no record found in %s\n", pathroot);
+		return -1;
+	}
+	srand(1);
+	for (i = 0; i < ncone; ++i) {
+		ra[i]     = rand() / (RAND_MAX + 1.0) * 360.0;
+		dec[i]    = asin(rand() / (RAND_MAX + 1.0) * 2.0 - 1.0) * R2D;
+		radius[i] = 1.0 + rand() / (RAND_MAX + 1.0);
+	}
+	// 检查天极与赤经0点附近的区域
+	double edges[][2] = { { 0.3, 10.0 }, { 359.7, -20.0 }, { 45.0, 89.5 }, { 200.0, -89.2 }, { 0.0, 90.0 }, { 1.0, 88.0 } };
+	for (i = 0; i < 6; ++i) {
+		ra[i]  = edges[i][0];
+		dec[i] = edges[i][1];
+	}
+
+	sprintf (filepath, "%s/tycho2_bench.dat", pathroot);
+	for (j = 0; j < 2; ++j) {
+		StarTable sorted(table);
+		ZoneIndex zi;
+		sort_catalog(sorted, 0, SORT_RADIX, schemes[j]);
+		if (!ZoneIndex::Save(filepath, sorted, schemes[j], nside) || !zi.Load(filepath)) return -1;
+
+		steady_clock::time_point t0 = steady_clock::now();
+		for (i = 0, nfound = 0; i < ncone; ++i) nfound += zi.ConeSearch(ra[i], dec[i], radius[i], 99.0, result);
+		double dt = duration<double>(steady_clock::now() - t0).count();
+
+		for (i = 0; i < ncheck; ++i) {
+			zi.ConeSearch(ra[i], dec[i], radius[i], 99.0, result);
+			cone_brute(zi, ra[i], dec[i], radius[i], expect);
+			sort(result.begin(), result.end());
+			if (result != expect) ++nmis;
+		}
+		printf ("%-12s: %8.2f us per cone, %8.1f stars per cone\n", names[j], dt * 1E6 / ncone, double(nfound) / ncone);
+		remove(filepath);
+	}
+
+	// 全表扫描: 三角函数计算角距与点积判定的对比
+	const int nsweep(20);
+	const double scale = MAS2D * D2R;
+	ATimeSpace ats;
+	vector<uint32_t> trig;
+	double dt[3] = { 0.0, 0.0, 0.0 };
+	uint32_t k, n(uint32_t(table.Size()));
+	int ndiff(0);
+
+	for (i = 0; i < nsweep; ++i) {
+		double center[3], cosr = cos(radius[i] * D2R);
+		double l0 = ra[i] * D2R, b0 = dec[i] * D2R, r0 = radius[i] * D2R;
+		unit_vector(ra[i], dec[i], center);
+
+		steady_clock::time_point t0 = steady_clock::now();
+		trig.clear();
+		for (k = 0; k < n; ++k) {
+			if (ats.SphereAngle(table.ra[k] * scale, table.spd[k] * scale - API * 0.5, l0, b0) <= r0) trig.push_back(k);
+		}
+		steady_clock::time_point t1 = steady_clock::now();
+		enable_simd_kernel(false);
+		result.clear();
+		select_in_cone(table.x.data(), table.y.data(), table.z.data(), NULL, 0, n, center, cosr, 0, result);
+		steady_clock::time_point t2 = steady_clock::now();
+		enable_simd_kernel(true);
+		expect.clear();
+		select_in_cone(table.x.data(), table.y.data(), table.z.data(), NULL, 0, n, center, cosr, 0, expect);
+		steady_clock::time_point t3 = steady_clock::now();
+
+		dt[0] += duration<double>(t1 - t0).count();
+		dt[1] += duration<double>(t2 - t1).count();
+		dt[2] += duration<double>(t3 - t2).count();
+		if (result != expect) ++nmis;
+		ndiff += abs(int(trig.size()) - int(expect.size()));
+	}
+	printf ("full scan of %u stars:\n", n);
+	printf ("SphereAngle : %8.3f ms per cone\n", dt[0] * 1E3 / nsweep);
+	printf ("scalar      : %8.3f ms per cone\n", dt[1] * 1E3 / nsweep);
+	printf ("%-12s: %8.3f ms per cone\n", kernel_name(), dt[2] * 1E3 / nsweep);
+	printf ("%d stars on the boundary differ between SphereAngle and dot product\n", ndiff);
+	printf ("%d cones differ from brute-force or scalar search\n", nmis);
+	return nmis ? -1 : 0;
+}
+
+int bench_kdtree(const char *pathroot) {
+	const size_t tycho2(2539913);	// Tycho-2星数
+	const int nquery(2000), ncheck(50), kbright(20);
+	const double radii[] = { 1.0, 2.0, 4.0 };
+	StarTable table, synth;
+	vector<uint32_t> result, expect;
+	int i, j, nmis(0);
+
+	if (!load_cache(table, pathroot, 99.0)) load_catalog(table, pathroot);
+	if (!table.Size()) {
+		printf ("no record found in %s\n", pathroot);
+		return -1;
+	}
+	if (table.Size() < tycho2) {// 扩充至Tycho-2规模
+		synth_catalog(table, int((tycho2 + table.Size() - 1) / table.Size()), synth);
+		table.Swap(synth);
+	}
+	sort_catalog(table, 0, SORT_RADIX, SKY_HEALPIX);	// 与生成索引时相同, 星表已按天区排序
+	printf ("%zu stars, %u threads\n", table.Size(), thread::hardware_concurrency());
+
+	KdTree tree;
+	int nthreads[] = { 1, 0 };
+	for (j = 0; j < 2; ++j) {
+		steady_clock::time_point t0 = steady_clock::now();
+		tree.Build(table, nthreads[j]);
+		double dt = duration<double>(steady_clock::now() - t0).count();
+		printf ("build, %-6s    : %8.3f sec, depth %d\n", j ? "all" : "1", dt, tree.Depth());
+	}
+
+	// 同一棵树用于不同视场. 以星表中的星为中心
+	srand(2);
+	vector<uint32_t> refs(nquery);
+	for (i = 0; i < nquery; ++i) refs[i] = uint32_t(rand() / (RAND_MAX + 1.0) * table.Size());
+	for (j = 0; j < 3; ++j) {
+		double cosr = cos(radii[j] * D2R);
+		size_t nfound(0);
+
+		steady_clock::time_point t0 = steady_clock::now();
+		for (i = 0; i < nquery; ++i) {
+			double center[3] = { table.x[refs[i]], table.y[refs[i]], table.z[refs[i]] };
+			nfound += tree.RangeSearch(center, radii[j], result);
+		}
+		steady_clock::time_point t1 = steady_clock::now();
+		for (i = 0; i < nquery; ++i) {
+			double center[3] = { table.x[refs[i]], table.y[refs[i]], table.z[refs[i]] };
+			tree.Brightest(center, radii[j], kbright, result);
+		}
+		steady_clock::time_point t2 = steady_clock::now();
+		printf ("radius %.0f deg: range %8.2f us, %8.1f stars; brightest %d %8.2f us\n", radii[j],
+				duration<double>(t1 - t0).count() * 1E6 / nquery, double(nfound) / nquery, kbright,
+				duration<double>(t2 - t1).count() * 1E6 / nquery);
+
+		for (i = 0; i < ncheck; ++i) {
+			double center[3] = { table.x[refs[i]], table.y[refs[i]], table.z[refs[i]] };
+			expect.clear();
+			select_in_cone(table.x.data(), table.y.data(), table.z.data(), NULL, 0, uint32_t(table.Size()),
+					center, cosr, 0, expect);
+			tree.RangeSearch(center, radii[j], result);
+			sort(result.begin(), result.end());
+			if (result != expect) ++nmis;
+
+			vector<pair<int16_t, uint32_t> > bright(expect.size());
+			for (size_t k = 0; k < expect.size(); ++k) bright[k] = make_pair(table.mag[expect[k]], expect[k]);
+			sort(bright.begin(), bright.end());
+			if (bright.size() > size_t(kbright)) bright.resize(kbright);
+			tree.Brightest(center, radii[j], kbright, result);
+			bool same = result.size() == bright.size();
+			for (size_t k = 0; same && k < bright.size(); ++k) same = result[k] == bright[k].second;
+			if (!same) ++nmis;
+		}
+	}
+	printf ("%d queries differ from brute-force search\n", nmis);
+	return nmis ? -1 : 0;
+}
+
+/*!
+ * @class PerfCounter 硬件缓存访问与缺失计数
+ */
+class PerfCounter {
+protected:
+	int fd_[2];	//< 缓存访问、缓存缺失计数器
+
+public:
+	PerfCounter() {
+		fd_[0] = fd_[1] = -1;
+	}
+
+	virtual ~PerfCounter() {
+		for (int i = 0; i < 2; ++i) {
+			if (fd_[i] >= 0) close(fd_[i]);
+		}
+	}
+
+	/*!
+	 * @brief 打开计数器
+	 * @return
+	 * 系统是否支持
+	 */
+	bool Open() {
+		const uint64_t config[2] = { PERF_COUNT_HW_CACHE_REFERENCES, PERF_COUNT_HW_CACHE_MISSES };
+		struct perf_event_attr attr;
+
+		for (int i = 0; i < 2; ++i) {
+			memset(&attr, 0, sizeof(attr));
+			attr.type   = PERF_TYPE_HARDWARE;
+			attr.size   = sizeof(attr);
+			attr.config = config[i];
+			attr.disabled       = 1;
+			attr.exclude_kernel = 1;
+			attr.exclude_hv     = 1;
+			fd_[i] = int(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+			if (fd_[i] < 0) return false;
+		}
+		return true;
+	}
+
+	void Start() {
+		for (int i = 0; i < 2; ++i) {
+			ioctl(fd_[i], PERF_EVENT_IOC_RESET, 0);
+			ioctl(fd_[i], PERF_EVENT_IOC_ENABLE, 0);
+		}
+	}
+
+	void Stop(uint64_t &refs, uint64_t &misses) {
+		uint64_t count[2] = { 0, 0 };
+		for (int i = 0; i < 2; ++i) {
+			ioctl(fd_[i], PERF_EVENT_IOC_DISABLE, 0);
+			if (read(fd_[i], &count[i], sizeof(uint64_t)) != sizeof(uint64_t)) count[i] = 0;
+		}
+		refs   = count[0];
+		misses = count[1];
+	}
+};
+
+/*!
+ * @class CacheSim 组相联LRU缓存模拟
+ */
+class CacheSim {
+protected:
+	enum {
+		LINE_BITS = 6,		//< 缓存行64字节
+		NWAY = 8,			//< 组相联路数
+		NSET = 512			//< 组数. 容量 = 64 * 8 * 512 = 256KB, 相当于L2缓存
+	};
+	std::vector<uintptr_t> tags_;	//< 各组的缓存行, 按最近访问排列
+
+public:
+	uint64_t access, miss;	//< 访问与缺失次数
+
+public:
+	CacheSim() : tags_(NSET * NWAY, 0) {
+		access = miss = 0;
+	}
+
+	void Touch(const void *addr) {
+		uintptr_t line = (uintptr_t(addr) >> LINE_BITS) + 1;
+		uintptr_t *set = &tags_[(line % NSET) * NWAY];
+		int i;
+
+		++access;
+		for (i = 0; i < NWAY - 1 && set[i] != line; ++i);
+		if (set[i] != line) ++miss;
+		for (; i > 0; --i) set[i] = set[i - 1];
+		set[0] = line;
+	}
+};
+
+int bench_cache(const char *pathroot) {
+	const double radius(1.0);
+	const char *names[] = { "RA/Dec grid", "HEALPix NESTED", "Hilbert curve" };
+	const int schemes[] = { SKY_GRID, SKY_HEALPIX, SKY_HILBERT };
+	StarTable table;
+	vector<uint32_t> result, nb;
+	uint64_t nfound[3];
+
+	if (!load_cache(table, pathroot, 99.0)) load_catalog(table, pathroot);
+	if (!table.Size()) {
+		printf ("no record found in %s\n", pathroot);
+		return -1;
+	}
+	size_t i, k, n = table.Size();
+	PerfCounter perf;
+	bool hw = perf.Open();
+	if (!hw) printf ("hardware cache counters unavailable, simulating a 256KB 8-way LRU cache\n");
+	printf ("%zu stars as centers, radius %.1f degrees\n", n, radius);
+
+	for (int j = 0; j < 3; ++j) {
+		StarTable sorted(table);
+		KdTree tree;
+		sort_catalog(sorted, 0, SORT_RADIX, schemes[j]);
+		tree.Build(sorted);
+		const double *x = sorted.x.data(), *y = sorted.y.data(), *z = sorted.z.data();
+		const int16_t *mag = sorted.mag.data();
+
+		// 按存储顺序以每颗星为参考星, 与ShapeEngine::Neighbours及星形构建相同:
+		// 检索邻域, 按星等筛选并选择最亮的暗星, 再读取其单位矢量
+		CacheSim sim;
+		uint64_t refs(0), misses(0);
+		double sum(0.0), a[3];
+		nfound[j] = 0;
+		if (hw) perf.Start();
+		steady_clock::time_point t0 = steady_clock::now();
+		for (i = 0; i < n; ++i) {
+			if (!hw) {
+				sim.Touch(x + i);
+				sim.Touch(y + i);
+				sim.Touch(z + i);
+				sim.Touch(mag + i);
+			}
+			a[0] = x[i];
+			a[1] = y[i];
+			a[2] = z[i];
+			nfound[j] += tree.RangeSearch(a, radius, result);
+
+			auto brighter = [mag](uint32_t p, uint32_t q) {
+				return mag[p] < mag[q] || (mag[p] == mag[q] && p < q);
+			};
+			nb.clear();
+			for (k = 0; k < result.size(); ++k) {
+				uint32_t m = result[k];
+				if (!hw) sim.Touch(mag + m);
+				if (brighter(i, m)) nb.push_back(m);
+			}
+			if (nb.size() > SHAPE_NEIGHBOUR) {
+				partial_sort(nb.begin(), nb.begin() + SHAPE_NEIGHBOUR, nb.end(), brighter);
+				nb.resize(SHAPE_NEIGHBOUR);
+			}
+			for (k = 0; k < nb.size(); ++k) {
+				uint32_t m = nb[k];
+				if (!hw) {
+					sim.Touch(x + m);
+					sim.Touch(y + m);
+					sim.Touch(z + m);
+				}
+				sum += a[0] * x[m] + a[1] * y[m] + a[2] * z[m];
+			}
+		}
+		double dt = duration<double>(steady_clock::now() - t0).count();
+		if (hw) perf.Stop(refs, misses);
+		else {
+			refs   = sim.access;
+			misses = sim.miss;
+		}
+		volatile double sink = sum;
+		(void) sink;
+
+		printf ("%-15s: %6.2f us per center, %6.1f stars, %s miss rate %6.2f%%, %6.1f misses per center\n",
+				names[j], dt * 1E6 / n, double(nfound[j]) / n, hw ? "cache" : "simulated",
+				refs ? misses * 100.0 / refs : 0.0, double(misses) / n);
+	}
+	bool same = nfound[0] == nfound[1] && nfound[1] == nfound[2];
+	printf ("neighbour counts are %s\n", same ? "identical" : "different");
+	return same ? 0 : -1;
+}
+
+int bench_propagate(const char *pathroot, int nside, double epoch) {
+	const int ncone(2000), ncheck(100);
+	const double years = epoch - CATALOG_EPOCH;
+	char filepath[256];
+	StarTable table;
+	vector<double> ra(ncone), dec(ncone), radius(ncone);
+	vector<uint32_t> result, expect;
+	size_t nfound[3];
+	double dt[3];
+	int i, j, nmis(0);
+
+	if (!load_cache(table, pathroot, 99.0)) load_catalog(table, pathroot);
+	if (!table.Size()) {
+		printf ("no record found in %s\n", pathroot);
+		return -1;
+	}
+	sort_catalog(table, 0, SORT_RADIX, SKY_HEALPIX);
+	size_t k, n = table.Size();
+	printf ("%zu stars, epoch %.2f\n", n, epoch);
+
+	// 全表外推: 标量与向量实现
+	vector<double> sx(n), sy(n), sz(n), vx(n), vy(n), vz(n);
+	enable_simd_kernel(false);
+	steady_clock::time_point t0 = steady_clock::now();
+	propagate_vectors(table.x.data(), table.y.data(), table.z.data(), table.pmra.data(), table.pmdc.data(), n, years,
+			sx.data(), sy.data(), sz.data());
+	steady_clock::time_point t1 = steady_clock::now();
+	enable_simd_kernel(true);
+	propagate_vectors(table.x.data(), table.y.data(), table.z.data(), table.pmra.data(), table.pmdc.data(), n, years,
+			vx.data(), vy.data(), vz.data());
+	steady_clock::time_point t2 = steady_clock::now();
+	size_t ndiff(0);
+	double shift(0.0);	// 最大位移, 量纲: 角秒
+	for (k = 0; k < n; ++k) {
+		if (sx[k] != vx[k] || sy[k] != vy[k] || sz[k] != vz[k]) ++ndiff;
+		double dx = sx[k] - table.x[k], dy = sy[k] - table.y[k], dz = sz[k] - table.z[k];
+		double d = sqrt(dx * dx + dy * dy + dz * dz) * R2AS;
+		if (d > shift) shift = d;
+	}
+	printf ("propagate all, scalar: %8.3f ms\n", duration<double>(t1 - t0).count() * 1E3);
+	printf ("propagate all, %-6s: %8.3f ms\n", kernel_name(), duration<double>(t2 - t1).count() * 1E3);
+	printf ("%zu stars differ between scalar and %s, largest shift %.1f arcsec\n", ndiff, kernel_name(), shift);
+
+	srand(1);
+	for (i = 0; i < ncone; ++i) {
+		ra[i]     = rand() / (RAND_MAX + 1.0) * 360.0;
+		dec[i]    = asin(rand() / (RAND_MAX + 1.0) * 2.0 - 1.0) * R2D;
+		radius[i] = 1.0 + rand() / (RAND_MAX + 1.0);
+	}
+	sprintf (filepath, "%s/tycho2_bench.dat", pathroot);
+	ZoneIndex zi;
+	if (!ZoneIndex::Save(filepath, table, SKY_HEALPIX, nside) || !zi.Load(filepath)) return -1;
+	remove(filepath);
+
+	// J2000, 首次外推, 使用缓存
+	for (j = 0; j < 3; ++j) {
+		zi.SetEpoch(j ? epoch : CATALOG_EPOCH);
+		t0 = steady_clock::now();
+		for (i = 0, nfound[j] = 0; i < ncone; ++i) nfound[j] += zi.ConeSearch(ra[i], dec[i], radius[i], 99.0, result);
+		dt[j] = duration<double>(steady_clock::now() - t0).count();
+	}
+	printf ("J2000       : %8.2f us per cone, %8.1f stars per cone\n", dt[0] * 1E6 / ncone, double(nfound[0]) / ncone);
+	printf ("first pass  : %8.2f us per cone, %8.1f stars per cone\n", dt[1] * 1E6 / ncone, double(nfound[1]) / ncone);
+	printf ("cached      : %8.2f us per cone, %8.1f stars per cone\n", dt[2] * 1E6 / ncone, double(nfound[2]) / ncone);
+	printf ("%zu of %zu stars propagated\n", zi.Propagated(), n);
+
+	for (i = 0; i < ncheck; ++i) {
+		double center[3], cosr = cos(radius[i] * D2R);
+		unit_vector(ra[i], dec[i], center);
+		expect.clear();
+		for (k = 0; k < n; ++k) {
+			if (sx[k] * center[0] + sy[k] * center[1] + sz[k] * center[2] >= cosr) expect.push_back(uint32_t(k));
+		}
+		zi.ConeSearch(ra[i], dec[i], radius[i], 99.0, result);
+		sort(result.begin(), result.end());
+		if (result != expect) ++nmis;
+	}
+	printf ("%d cones differ from brute-force search\n", nmis);
+	return nmis || ndiff ? -1 : 0;
+}
+
+/*!
+ * @brief 将星形按首维哈希码排序
+ */
+static void sort_shapes(ShapeSet &shapes) {
+	size_t i, n = shapes.Size();
+	int dim = shapes.dim, nstar = shapes.nstar;
+	vector<uint32_t> order(n);
+	ShapeSet sorted;
+
+	for (i = 0; i < n; ++i) order[i] = uint32_t(i);
+	stable_sort(order.begin(), order.end(), [&shapes, dim](uint32_t p, uint32_t q) {
+		return shapes.code[p * dim] < shapes.code[q * dim];
+	});
+	sorted.Reset(nstar);
+	sorted.code.resize(n * dim);
+	sorted.star.resize(n * nstar);
+	for (i = 0; i < n; ++i) {
+		copy(&shapes.code[order[i] * dim], &shapes.code[order[i] * dim] + dim, &sorted.code[i * dim]);
+		copy(&shapes.star[order[i] * nstar], &shapes.star[order[i] * nstar] + nstar, &sorted.star[i * nstar]);
+	}
+	shapes.code.swap(sorted.code);
+	shapes.star.swap(sorted.star);
+}
+
+/*!
+ * @brief 在按首维排序的星形中检索哈希码相近的星形
+ */
+static int lookup_shapes(const ShapeSet &shapes, const double *code, double tol, vector<uint32_t> &result) {
+	size_t n = shapes.Size(), lo(0), hi(n), i;
+	int dim = shapes.dim, j;
+
+	result.clear();
+	while (lo < hi) {
+		size_t mid = (lo + hi) / 2;
+		if (shapes.code[mid * dim] < code[0] - tol) lo = mid + 1;
+		else hi = mid;
+	}
+	for (i = lo; i < n && shapes.code[i * dim] <= code[0] + tol; ++i) {
+		const double *c = &shapes.code[i * dim];
+		for (j = 1; j < dim && fabs(c[j] - code[j]) <= tol; ++j);
+		if (j == dim) result.push_back(uint32_t(i));
+	}
+	return int(result.size());
+}
+
+int bench_triangle(const char *pathroot, double fov, double faint) {
+	const int nquery(20000);
+	const double tol(0.01);
+	char filepath[256];
+	StarTable table;
+	vector<uint32_t> result;
+	int i, j, nmiss(0), nmiss_tree(0);
+
+	if (!load_cache(table, pathroot, faint)) load_catalog(table, pathroot, faint);
+	if (!table.Size()) {
+		printf ("no record found in %s\n", pathroot);
+		return -1;
+	}
+	sort_catalog(table, 0, SORT_RADIX, SKY_HEALPIX);
+	printf ("%zu stars brighter than %.1f, FOV %g degrees, tolerance %g\n", table.Size(), faint, fov, tol);
+	sprintf (filepath, "%s/tycho2_bench.dat", pathroot);
+
+	for (int nstar = 3; nstar <= 4; ++nstar) {
+		int nside = uniform_nside(fov);
+		StarTable::IndexVec keep;
+		StarTable stars;
+		KdTree tree;
+		uniformize(table, nside, uniform_quota(fov, nstar, nside), keep);
+		table.Gather(keep.data(), keep.size(), stars);
+		tree.Build(stars);
+
+		TriangleSet tris;
+		ShapeSet shapes;
+		size_t nshape, bytes, nfound(0);
+		steady_clock::time_point t0 = steady_clock::now();
+		if (nstar == 3) {
+			nshape = TriangleEngine().Build(stars, tree, fov, tris);
+			bytes  = tris.Bytes();
+		}
+		else {
+			nshape = ShapeEngine(nstar).Build(stars, tree, fov, shapes);
+			sort_shapes(shapes);
+			bytes  = shapes.Bytes();
+		}
+		double tbuild = duration<double>(steady_clock::now() - t0).count();
+		if (!nshape) {
+			printf ("no shape of %d stars built\n", nstar);
+			return -1;
+		}
+
+		// 检索值: 随机星形的哈希码加扰动
+		int dim = nstar == 3 ? 2 : shapes.dim;
+		vector<uint32_t> src(nquery);
+		vector<double> query(nquery * dim);
+		srand(1);
+		for (i = 0; i < nquery; ++i) {
+			src[i] = uint32_t(rand() / (RAND_MAX + 1.0) * nshape);
+			for (j = 0; j < dim; ++j) {
+				double c = nstar == 3 ? tris.code[src[i] * 2 + j] : shapes.code[src[i] * dim + j];
+				query[i * dim + j] = c + (rand() / (RAND_MAX + 1.0) - 0.5) * tol;
+			}
+		}
+
+		t0 = steady_clock::now();
+		for (i = 0; i < nquery; ++i) {
+			const double *q = &query[i * dim];
+			if (nstar == 3) nfound += tris.Lookup(q[0], q[1], tris.parity[src[i]], tol, result);
+			else nfound += lookup_shapes(shapes, q, tol, result);
+			if (find(result.begin(), result.end(), src[i]) == result.end()) ++nmiss;
+		}
+		double tlookup = duration<double>(steady_clock::now() - t0).count();
+
+		// 索引文件: 与IndexBuilder相同, 三角形为单精度哈希码与奇偶性标记, 四边形为双精度哈希码
+		CodeTree built, codes;
+		struct stat st;
+		t0 = steady_clock::now();
+		if (nstar == 3) {
+			vector<double> code(tris.code.begin(), tris.code.end());
+			built.Build(code.data(), tris.star.data(), tris.parity.data(), nshape, 2, 3, 0, CODE_TREE_LEAFSIZE,
+					CODE_FLOAT);
+		}
+		else {
+			built.Build(shapes.code.data(), shapes.star.data(), NULL, nshape, dim, nstar, 0, CODE_TREE_LEAFSIZE,
+					CODE_DOUBLE);
+		}
+		double ttree = duration<double>(steady_clock::now() - t0).count();
+		if (!built.Save(filepath) || stat(filepath, &st) || !codes.Load(filepath)) return -1;
+
+		size_t nfound_tree(0);
+		t0 = steady_clock::now();
+		for (i = 0; i < nquery; ++i) {
+			const double *q = &query[i * dim];
+			nfound_tree += codes.Search(q, tol, result, NULL, nstar == 3 ? tris.parity[src[i]] : -1);
+		}
+		double tsearch = duration<double>(steady_clock::now() - t0).count();
+		for (i = 0; i < nquery; ++i) {// 以星序号确认源星形
+			const uint32_t *expect = nstar == 3 ? &tris.star[src[i] * 3] : &shapes.star[size_t(src[i]) * nstar];
+			const double *q = &query[i * dim];
+			codes.Search(q, tol, result, NULL, nstar == 3 ? tris.parity[src[i]] : -1);
+			for (j = 0; j < int(result.size()) && !equal(expect, expect + nstar, codes.Stars(result[j])); ++j);
+			if (j == int(result.size())) ++nmiss_tree;
+		}
+		remove(filepath);
+
+		printf ("%-9s: %zu stars, %9zu shapes, build %7.3f sec\n", nstar == 3 ? "triangle" : "quad", stars.Size(),
+				nshape, tbuild);
+		printf ("  memory : %7.2f MB, lookup %7.2f us, %8.1f candidates\n", bytes / 1048576.0,
+				tlookup * 1E6 / nquery, double(nfound) / nquery);
+		printf ("  file   : %7.2f MB, code tree build %7.3f sec, lookup %7.2f us, %8.1f candidates\n",
+				st.st_size / 1048576.0, ttree, tsearch * 1E6 / nquery, double(nfound_tree) / nquery);
+	}
+	printf ("%d queries missed their source shape in memory, %d in code tree file\n", nmiss, nmiss_tree);
+	return nmiss || nmiss_tree ? -1 : 0;
+}
+
+/*!
+ * @brief 对比N颗星的特化与通用实现
+ * @return
+ * 结果不一致的项数
+ */
+template <int N>
+static int bench_shape_n(const StarTable &table, double fov) {
+	typedef ShapeKernel<N> Kernel;
+	const int nquery(200);
+	const double tol(0.01);
+	int nside = uniform_nside(fov), nmis(0), i;
+	StarTable::IndexVec keep;
+	StarTable stars;
+	KdTree tree;
+	ShapeSet generic, fixed;
+	ShapeEngine engine(N);
+	FixedShapeEngine<N> fixeng;
+
+	uniformize(table, nside, uniform_quota(fov, N, nside), keep);
+	table.Gather(keep.data(), keep.size(), stars);
+	tree.Build(stars);
+	engine.Build(stars, tree, fov, generic);
+	fixeng.Build(stars, tree, fov, fixed);
+	if (generic.code != fixed.code || generic.star != fixed.star) ++nmis;
+
+	// 以相同的星序号重新计算全部哈希码
+	size_t k, n = generic.Size();
+	vector<uint32_t> star1(generic.star), star2(generic.star);
+	vector<double> code1(generic.code.size()), code2(generic.code.size());
+	steady_clock::time_point t0 = steady_clock::now();
+	for (k = 0; k < n; ++k) ShapeEngine::MakeCode(stars, &star1[k * N], N, &code1[k * Kernel::DIM]);
+	steady_clock::time_point t1 = steady_clock::now();
+	for (k = 0; k < n; ++k) Kernel::MakeCode(stars, &star2[k * N], &code2[k * Kernel::DIM]);
+	steady_clock::time_point t2 = steady_clock::now();
+	if (code1 != code2 || star1 != star2) ++nmis;
+
+	// 逐一比较哈希码
+	size_t nfound[2] = { 0, 0 };
+	int nq = n ? nquery : 0;
+	const double *codes = generic.code.data();
+	steady_clock::time_point t3 = steady_clock::now();
+	for (i = 0; i < nq; ++i) {
+		const double *q = codes + (n * i / nq) * Kernel::DIM;
+		for (k = 0; k < n; ++k) nfound[0] += ShapeEngine::CodeWithin(q, codes + k * Kernel::DIM, Kernel::DIM, tol);
+	}
+	steady_clock::time_point t4 = steady_clock::now();
+	for (i = 0; i < nq; ++i) {
+		const double *q = codes + (n * i / nq) * Kernel::DIM;
+		for (k = 0; k < n; ++k) nfound[1] += Kernel::Within(q, codes + k * Kernel::DIM, tol);
+	}
+	steady_clock::time_point t5 = steady_clock::now();
+	if (nfound[0] != nfound[1]) ++nmis;
+
+	double ncmp = double(n) * nq;
+	printf ("N=%-2d: %8zu shapes, build %6.3f / %6.3f sec, code %6.1f / %6.1f ns, compare %5.2f / %5.2f ns\n",
+			N, n, engine.Seconds(), fixeng.Seconds(),
+			n ? duration<double>(t1 - t0).count() * 1E9 / n : 0.0, n ? duration<double>(t2 - t1).count() * 1E9 / n : 0.0,
+			ncmp > 0 ? duration<double>(t4 - t3).count() * 1E9 / ncmp : 0.0,
+			ncmp > 0 ? duration<double>(t5 - t4).count() * 1E9 / ncmp : 0.0);
+	return nmis;
+}
+
+int bench_shape(const char *pathroot, double fov, double faint) {
+	StarTable table;
+	int nmis(0);
+
+	if (!load_cache(table, pathroot, faint)) load_catalog(table, pathroot, faint);
+	if (!table.Size()) {
+		printf ("no record found in %s\n", pathroot);
+		return -1;
+	}
+	sort_catalog(table, 0, SORT_RADIX, SKY_HEALPIX);
+	printf ("%zu stars brighter than %.1f, FOV %g degrees. generic / fixed:\n", table.Size(), faint, fov);
+	nmis += bench_shape_n<3>(table, fov);
+	nmis += bench_shape_n<4>(table, fov);
+	nmis += bench_shape_n<5>(table, fov);
+	nmis += bench_shape_n<6>(table, fov);
+	nmis += bench_shape_n<7>(table, fov);
+	nmis += bench_shape_n<8>(table, fov);
+	nmis += bench_shape_n<9>(table, fov);
+	nmis += bench_shape_n<10>(table, fov);
+	printf ("%d results differ between generic and fixed implementations\n", nmis);
+	return nmis ? -1 : 0;
+}
+
+int bench_codetree(const char *pathroot, double fov, double faint) {
+	const int nstar(4), nquery(20000);
+	const double tol(0.01);
+	char filepath[256];
+	StarTable table, stars;
+	StarTable::IndexVec keep;
+	KdTree tree;
+	ShapeSet shapes;
+	vector<uint32_t> result;
+	int i, j, nmiss(0);
+
+	if (!load_cache(table, pathroot, faint)) load_catalog(table, pathroot, faint);
+	if (!table.Size()) {
+		printf ("no record found in %s\n", pathroot);
+		return -1;
+	}
+	sort_catalog(table, 0, SORT_RADIX, SKY_HEALPIX);
+	int nside = uniform_nside(fov);
+	uniformize(table, nside, uniform_quota(fov, nstar, nside), keep);
+	table.Gather(keep.data(), keep.size(), stars);
+	tree.Build(stars);
+	FixedShapeEngine<nstar>().Build(stars, tree, fov, shapes);
+	size_t n = shapes.Size();
+	if (!n) {
+		printf ("no shape of %d stars built\n", nstar);
+		return -1;
+	}
+	int dim = shapes.dim, nthread = thread::hardware_concurrency();
+	printf ("%zu stars brighter than %.1f, FOV %g degrees, %zu shapes of %d stars, tolerance %g\n",
+			table.Size(), faint, fov, n, nstar, tol);
+
+	// 单线程与全部线程构建, 存储后内存映射加载
+	CodeTree built, loaded;
+	steady_clock::time_point t0 = steady_clock::now();
+	built.Build(shapes.code.data(), shapes.star.data(), NULL, n, dim, nstar, 1);
+	steady_clock::time_point t1 = steady_clock::now();
+	built.Build(shapes.code.data(), shapes.star.data(), NULL, n, dim, nstar, nthread);
+	steady_clock::time_point t2 = steady_clock::now();
+	sprintf (filepath, "%s/tycho2_bench.dat", pathroot);
+	if (!built.Save(filepath)) return -1;
+	steady_clock::time_point t3 = steady_clock::now();
+	bool rslt = loaded.Load(filepath);
+	steady_clock::time_point t4 = steady_clock::now();
+	remove(filepath);
+	if (!rslt) return -1;
+	printf ("build %.3f sec with 1 thread, %.3f sec with %d threads, save %.3f sec, load %.3f ms\n",
+			duration<double>(t1 - t0).count(), duration<double>(t2 - t1).count(), nthread,
+			duration<double>(t3 - t2).count(), duration<double>(t4 - t3).count() * 1E3);
+
+	// 检索值: 随机星形的哈希码加扰动
+	vector<uint32_t> src(nquery);
+	vector<double> query(nquery * dim);
+	srand(1);
+	for (i = 0; i < nquery; ++i) {
+		src[i] = uint32_t(rand() / (RAND_MAX + 1.0) * n);
+		for (j = 0; j < dim; ++j) {
+			query[i * dim + j] = shapes.code[src[i] * dim + j] + (rand() / (RAND_MAX + 1.0) - 0.5) * tol;
+		}
+	}
+
+	size_t nfound(0), nvisit(0), nv;
+	t0 = steady_clock::now();
+	for (i = 0; i < nquery; ++i) {
+		const double *q = &query[i * dim];
+		const uint32_t *s = &shapes.star[src[i] * nstar];
+		nfound += loaded.Search(q, tol, result, &nv);
+		nvisit += nv;
+		for (j = 0; j < int(result.size()) && !equal(s, s + nstar, loaded.Stars(result[j])); ++j);
+		if (j == int(result.size())) ++nmiss;
+	}
+	t1 = steady_clock::now();
+
+	// 与逐一比较的结果对照检索结果数
+	int nbrute(nquery / 100), ndiff(0);
+	for (i = 0; i < nbrute; ++i) {
+		const double *q = &query[i * dim];
+		size_t k, count(0);
+		for (k = 0; k < n; ++k) count += ShapeEngine::CodeWithin(q, &shapes.code[k * dim], dim, tol);
+		if (count != size_t(loaded.Search(q, tol, result))) ++ndiff;
+	}
+	t2 = steady_clock::now();
+
+	printf ("tree search %7.2f us, brute force %9.2f us, %6.1f candidates, %7.1f nodes visited, "
+			"depth %d, log2(n) = %.1f\n",
+			duration<double>(t1 - t0).count() * 1E6 / nquery, duration<double>(t2 - t1).count() * 1E6 / nbrute,
+			double(nfound) / nquery, double(nvisit) / nquery, loaded.Depth(), log2(double(n)));
+	printf ("%d queries missed their source shape, %d differ from brute force\n", nmiss, ndiff);
+	return nmiss || ndiff ? -1 : 0;
+}
+
+/*!
+ * @brief 标准正态分布随机数
+ */
+static double gauss_rand() {
+	double u = (rand() + 1.0) / (RAND_MAX + 2.0), v = rand() / (RAND_MAX + 1.0);
+	return sqrt(-2.0 * log(u)) * cos(2.0 * API * v);
+}
+
+int bench_quantize(const char *pathroot, double fov, double faint) {
+	typedef ShapeKernel<4> Kernel;
+	const int nstar(4), dim(Kernel::DIM), nsolve(20000);
+	const double tol(0.01), sigma(2.0);	// 容差与星位置误差(角秒)
+	char filepath[2][256];
+	StarTable table, stars, field;
+	StarTable::IndexVec keep;
+	KdTree tree;
+	ShapeSet shapes;
+	CodeTree trees[2];
+	struct stat st;
+	size_t bytes[2];
+	int i, j, k;
+
+	if (!load_cache(table, pathroot, faint)) load_catalog(table, pathroot, faint);
+	if (!table.Size()) {
+		printf ("no record found in %s\n", pathroot);
+		return -1;
+	}
+	sort_catalog(table, 0, SORT_RADIX, SKY_HEALPIX);
+	int nside = uniform_nside(fov);
+	uniformize(table, nside, uniform_quota(fov, nstar, nside), keep);
+	table.Gather(keep.data(), keep.size(), stars);
+	tree.Build(stars);
+	FixedShapeEngine<nstar>().Build(stars, tree, fov, shapes);
+	size_t n = shapes.Size();
+	if (!n) {
+		printf ("no shape of %d stars built\n", nstar);
+		return -1;
+	}
+	printf ("%zu stars brighter than %.1f, FOV %g degrees, %zu shapes of %d stars, tolerance %g, "
+			"position error %g arcsec\n", table.Size(), faint, fov, n, nstar, tol, sigma);
+
+	// 双精度与16位定点数哈希码各存储一个文件, 以内存映射加载
+	for (k = 0; k < 2; ++k) {
+		CodeTree built;
+		built.Build(shapes.code.data(), shapes.star.data(), NULL, n, dim, nstar, 0, CODE_TREE_LEAFSIZE,
+				k ? CODE_FIXED16 : CODE_DOUBLE);
+		sprintf (filepath[k], "%s/tycho2_bench%d.dat", pathroot, k);
+		if (!built.Save(filepath[k]) || stat(filepath[k], &st) || !trees[k].Load(filepath[k])) return -1;
+		bytes[k] = st.st_size;
+		remove(filepath[k]);
+	}
+	printf ("file size: double %.1f MB, 16-bit %.1f MB (%.2fx smaller), quantization error %.2g\n",
+			bytes[0] / 1048576.0, bytes[1] / 1048576.0, double(bytes[0]) / bytes[1], trees[1].QuantizeError());
+
+	// 模拟解算: 随机星形的星位置加入误差, 重新计算哈希码作为检索值
+	vector<double> query(nsolve * dim);
+	vector<uint32_t> src(nsolve * nstar);
+	double scale = sigma / R2AS;
+	srand(1);
+	for (i = 0; i < nsolve; ++i) {
+		uint32_t *s = &src[i * nstar], local[nstar] = { 0, 1, 2, 3 };
+		const uint32_t *star = &shapes.star[size_t(rand() / (RAND_MAX + 1.0) * n) * nstar];
+		stars.Gather(star, nstar, field);
+		for (j = 0; j < nstar; ++j) {
+			double x = field.x[j] + gauss_rand() * scale, y = field.y[j] + gauss_rand() * scale;
+			double z = field.z[j] + gauss_rand() * scale, r = 1.0 / sqrt(x * x + y * y + z * z);
+			field.x[j] = x * r;
+			field.y[j] = y * r;
+			field.z[j] = z * r;
+		}
+		Kernel::MakeCode(field, local, &query[i * dim]);
+		for (j = 0; j < nstar; ++j) s[j] = star[local[j]];
+	}
+
+	size_t nfound[2] = { 0, 0 }, nvisit[2] = { 0, 0 }, nv;
+	int nsolved[2] = { 0, 0 }, nlost(0);
+	double secs[2];
+	vector<uint32_t> result[2];
+	for (k = 0; k < 2; ++k) {
+		steady_clock::time_point t0 = steady_clock::now();
+		for (i = 0; i < nsolve; ++i) {
+			const uint32_t *s = &src[i * nstar];
+			nfound[k] += trees[k].Search(&query[i * dim], tol, result[k], &nv);
+			nvisit[k] += nv;
+			for (j = 0; j < int(result[k].size()) && !equal(s, s + nstar, trees[k].Stars(result[k][j])); ++j);
+			if (j < int(result[k].size())) ++nsolved[k];
+		}
+		secs[k] = duration<double>(steady_clock::now() - t0).count();
+	}
+	// 两棵树的树序相同: 双精度检索结果须包含于定点数检索结果
+	for (i = 0; i < nsolve; ++i) {
+		trees[0].Search(&query[i * dim], tol, result[0]);
+		trees[1].Search(&query[i * dim], tol, result[1]);
+		if (!includes(result[1].begin(), result[1].end(), result[0].begin(), result[0].end())) ++nlost;
+	}
+
+	const char *name[2] = { "double", "16-bit" };
+	for (k = 0; k < 2; ++k) {
+		printf ("%s: %5d / %d solved, search %6.2f us, %6.2f candidates, %6.1f nodes visited\n", name[k],
+				nsolved[k], nsolve, secs[k] * 1E6 / nsolve, double(nfound[k]) / nsolve, double(nvisit[k]) / nsolve);
+	}
+	printf ("%d queries lost matches with 16-bit codes\n", nlost);
+	return nlost || nsolved[1] < nsolved[0] ? -1 : 0;
+}
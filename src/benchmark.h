@@ -0,0 +1,146 @@
+/**
+ * @file benchmark.h 性能测试
+ */
+
+#ifndef BENCHMARK_H_
+#define BENCHMARK_H_
+
+/*!
+ * @brief 测试tyc2.dat.xx的解析速度
+ * @param pathroot  根路径
+ * @return
+ * 0: 新旧解析结果逐位一致; 其它: 不一致的记录数
+ * @note
+ * - 对比基于substr/trim/stod的原解析与基于定宽列的解析
+ */
+int bench_parser(const char *pathroot);
+
+/*!
+ * @brief 测试历元转换J1991.25=>J2000的速度与精度
+ * @param n  随机坐标数量
+ * @return
+ * 0: 批量与逐点转换的偏差小于0.1毫角秒; -1: 超差
+ */
+int bench_epoch(int n);
+
+/*!
+ * @brief 测试星表排序的速度
+ * @param pathroot  根路径
+ * @return
+ * 0: 各排序算法结果一致; -1: 不一致或无数据
+ * @note
+ * - 分别对原始星表与10倍规模的合成星表测试原实现的std::sort(基准)、归并排序与基数排序.
+ *   归并排序与基数排序各以单线程和全部线程运行
+ */
+int bench_sort(const char *pathroot);
+
+/*!
+ * @brief 测试分区索引文件的锥形检索
+ * @param pathroot  根路径
+ * @param nside     HEALPix的Nside
+ * @return
+ * 0: 检索结果与逐星比对一致; -1: 不一致或无数据
+ * @note
+ * - 对赤经赤纬分区与HEALPix分区, 各检索10000个半径1~2度的随机锥形区域,
+ *   并以逐星比对检查其中的部分区域, 包括天极附近与跨越赤经0点的区域
+ * - 对全表扫描, 比较SphereAngle()、标量点积与向量点积的耗时, 并检查
+ *   向量与标量结果一致
+ */
+int bench_cone(const char *pathroot, int nside);
+
+/*!
+ * @brief 测试kd树的构建与检索
+ * @param pathroot  根路径
+ * @return
+ * 0: 检索结果与逐星比对一致; -1: 不一致或无数据
+ * @note
+ * - 星表不足Tycho-2规模时, 以合成星表扩充. 星表按HEALPix像元排序后构建
+ * - 分别以单线程与全部线程构建, 再以同一棵树检索半径1、2、4度的范围
+ *   及其中最亮的20颗星
+ */
+int bench_kdtree(const char *pathroot);
+
+/*!
+ * @brief 测试星的排列顺序对邻域检索访存的影响
+ * @param pathroot  根路径
+ * @return
+ * 0: 各排列顺序的检索结果一致; -1: 不一致或无数据
+ * @note
+ * - 星表分别按赤经赤纬分区、HEALPix NESTED(Morton)与Hilbert曲线排列并构建kd树,
+ *   三种顺序使用相同的遍历: 按存储顺序以每颗星为参考星, 由KdTree::RangeSearch检索
+ *   半径1度的邻域, 读取邻星星等筛选暗星, 再读取最亮暗星的单位矢量, 与构建星形相同
+ * - 以perf_event_open()读取硬件缓存访问与缺失次数. 系统不支持时, 以8路组相联
+ *   256KB LRU缓存(相当于L2缓存)模拟星表x、y、z、mag各列读取的缺失率
+ */
+int bench_cache(const char *pathroot);
+
+/*!
+ * @brief 测试按分区外推自行的锥形检索
+ * @param pathroot  根路径
+ * @param nside     HEALPix的Nside
+ * @param epoch     观测历元
+ * @return
+ * 0: 向量与标量外推一致, 且检索结果与逐星比对一致; -1: 不一致或无数据
+ * @note
+ * - 比较标量与向量实现外推全表的耗时
+ * - 以HEALPix分区检索2000个半径1~2度的随机锥形区域, 比较J2000、首次外推与使用缓存的耗时,
+ *   并与全表外推后的逐星比对检查其中的部分区域
+ */
+int bench_propagate(const char *pathroot, int nside, double epoch);
+
+/*!
+ * @brief 对比三角形与四边形索引
+ * @param pathroot  根路径
+ * @param fov       视场直径, 量纲: 角度
+ * @param faint     极限星等
+ * @return
+ * 0: 两种索引的检索均找到全部源星形; -1: 有遗漏或无数据
+ * @note
+ * - 两种索引由同一星表按各自星数均匀化, 使用相同视场与极限星等
+ * - 四边形按首维哈希码排序后, 与三角形相同以二分查找检索
+ * - 以随机选取的星形哈希码加入半个容差以内的扰动作为检索值, 比较存储量、构建耗时与检索耗时
+ * - 另按IndexBuilder的格式构建并存储哈希码kd树(三角形: 单精度哈希码与奇偶性标记; 四边形: 双精度哈希码),
+ *   内存映射加载后比较文件长度与CodeTree检索耗时
+ */
+int bench_triangle(const char *pathroot, double fov, double faint);
+
+/*!
+ * @brief 对比星数特化与通用实现的星形生成和哈希码比较
+ * @param pathroot  根路径
+ * @param fov       视场直径, 量纲: 角度
+ * @param faint     极限星等
+ * @return
+ * 0: 两种实现的结果一致; -1: 不一致或无数据
+ * @note
+ * - 对N=3~10, 分别以ShapeEngine与FixedShapeEngine<N>生成星形, 并对全部星形重新计算哈希码
+ * - 以部分星形的哈希码为检索值, 与全部星形逐一比较, 对比通用与定长比较函数
+ */
+int bench_shape(const char *pathroot, double fov, double faint);
+
+/*!
+ * @brief 测试星形哈希码kd树的构建、存储加载与容差检索
+ * @param pathroot  根路径
+ * @param fov       视场直径, 量纲: 角度
+ * @param faint     极限星等
+ * @return
+ * 0: 检索均找到源星形且与逐一比较的结果一致; -1: 不一致或无数据
+ * @note
+ * - 以四边形为例, 对比单线程与全部线程的构建耗时, 存储后以内存映射加载
+ * - 检索值同bench_triangle(), 统计每次检索访问的节点数
+ */
+int bench_codetree(const char *pathroot, double fov, double faint);
+
+/*!
+ * @brief 以模拟解算对比双精度与16位定点数哈希码kd树
+ * @param pathroot  根路径
+ * @param fov       视场直径, 量纲: 角度
+ * @param faint     极限星等
+ * @return
+ * 0: 定点数检索未遗漏双精度检索的结果; -1: 有遗漏或无数据
+ * @note
+ * - 以四边形为例, 比较两种文件的大小
+ * - 随机选取星形, 其星位置加入正态分布误差后重新计算哈希码作为检索值. 检索结果包含该星形时视为解算成功
+ */
+int bench_quantize(const char *pathroot, double fov, double faint);
+
+#endif /* BENCHMARK_H_ */
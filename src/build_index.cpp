@@ -1,139 +1,970 @@
 /**
  * @file build_index.cpp 由tycho2星表生成星图匹配索引
  */
+#include <string.h>
 #include <iostream>
 #include <algorithm>
-#include <boost/algorithm/string/trim.hpp>
+#include <thread>
+#include <atomic>
+#include <sys/stat.h>
+#include <zlib.h>
 #include "ADefine.h"
 #include "build_index.h"
+#include "field_decode.h"
+#include "MappedFile.hpp"
+#include "SpscQueue.hpp"
+#include "RunThreads.hpp"
+#include "StarTable.h"
+#include "HEALPix.h"
+#include "ZoneIndex.h"
 
 using namespace std;
 using namespace AstroUtil;
-using namespace boost::algorithm;
 
-CatStarVec stars;
+int resolve_cat(const char *line, int len, CatStar &star, int maglim) {
+	if (len < layout_tyc2_mean.minlen) return RESOLVE_INVALID;
+	const RecordLayout &lay = line[13] == ' ' ? layout_tyc2_mean : layout_tyc2_obs;
+	if (len < lay.minlen) return RESOLVE_INVALID;
+	return decode_record_scalar(line, lay, maglim, star);
+}
 
-bool resolve_cat(const string &line, CatStar &star) {
-	string ra_str, dc_str, pmra_str, pmdc_str, bt_str, vt_str;
+int resolve_suppl(const char *line, int len, CatStar &star, int maglim) {
+	if (len < layout_suppl.minlen) return RESOLVE_INVALID;
+	return decode_record_scalar(line, layout_suppl, maglim, star);
+}
 
-	if (line[13] == ' ') {
-		ra_str   = line.substr(15, 12); trim(ra_str);
-		dc_str   = line.substr(28, 12); trim(dc_str);
-	}
-	else {
-		ra_str   = line.substr(152, 12); trim(ra_str);
-		dc_str   = line.substr(165, 12); trim(dc_str);
-	}
-	pmra_str = line.substr(41, 7);  trim(pmra_str);
-	pmdc_str = line.substr(49, 7);  trim(pmdc_str);
-	bt_str   = line.substr(110, 6); trim(bt_str);
-	vt_str   = line.substr(123, 6); trim(vt_str);
-	star.ra  = int(stod(ra_str) * D2MAS);
-	star.spd = int((stod(dc_str) + 90.0) * D2MAS);
-	if (pmra_str.size()) star.pmra = short(stod(pmra_str));
-	if (pmdc_str.size()) star.pmdc = short(stod(pmdc_str));
-	if (bt_str.size() || vt_str.size()) {
-		if (bt_str.size() && vt_str.size()) {
-			double vt = stod(vt_str);
-			star.mag = short((vt - 0.09 * (stod(bt_str) - vt)) * 1000.0);
+void to_J2000(ATimeSpace& ats, CatStar& star) {
+	to_J2000(ats, &star, 1);
+}
+
+void to_J2000(ATimeSpace& ats, CatStar* star, int n) {
+	const int szbatch(256);
+	double ra[szbatch], dc[szbatch];
+	double t = 2000.0 - ats.Epoch();
+	int i, j, k;
+
+	for (i = 0; i < n; i += k) {
+		k = n - i < szbatch ? n - i : szbatch;
+		for (j = 0; j < k; ++j) {
+			const CatStar &x = star[i + j];
+			ra[j] = (x.ra + x.pmra * t / cos((x.spd * MAS2D - 90.0) * D2R)) * MAS2D * D2R;
+			dc[j] = ((x.spd + x.pmdc * t) * MAS2D - 90.0) * D2R;
 		}
-		else {
-			star.mag = short((bt_str.size() ? stod(bt_str) : stod(vt_str)) * 1000.0);
+		ats.EqReTransfer(k, ra, dc, ra, dc);
+		for (j = 0; j < k; ++j) {
+			star[i + j].ra  = int(ra[j] * R2D * D2MAS);
+			star[i + j].spd = int((dc[j] * R2D + 90.0) * D2MAS);
 		}
-		return true;
 	}
-	return false;
 }
 
 /*!
- * @brief 解析Tycho2的补充星表
- * @param line 一行数据
+ * @struct StarSink 解析结果的存储位置
+ * @note
+ * - 优先写入星表中预留的区间, 超出预留区间的星暂存于spill
+ * - table为空时全部存储于spill
+ */
+struct StarSink {
+	StarTable *table;	//< 星表
+	size_t first;		//< 预留区间在星表中的起始序号
+	size_t capacity;	//< 预留区间长度
+	size_t count;		//< 已写入预留区间的星数
+	CatStarVec spill;	//< 超出预留区间的星
+
+public:
+	StarSink() {
+		table = NULL;
+		first = capacity = count = 0;
+	}
+
+	void Put(const CatStar &star) {
+		if (count < capacity) table->Set(first + count++, star);
+		else spill.push_back(star);
+	}
+};
+
+/*!
+ * @struct ChunkTask 并行解析任务: 内存映射文件中以记录边界对齐的一段
+ */
+struct ChunkTask {
+	const char *head;	//< 首字节
+	const char *tail;	//< 尾字节的下一字节
+	string gzpath;		//< gzip压缩文件路径. 非空时流式解压并解析整个文件
+	StarSink out;		//< 解析结果
+	size_t nfaint;		//< 暗于极限星等而被丢弃的记录数
+
+public:
+	ChunkTask() {
+		head = tail = NULL;
+		nfaint = 0;
+	}
+};
+
+/*!
+ * @brief tyc2.dat.xx与suppl_x.dat的记录长度, 含换行符
+ */
+#define TYC2_RECLEN		207
+#define SUPPL_RECLEN	123
+
+/*!
+ * @brief 星表文件解压后的长度
+ * @param filepath  文件路径
+ * @param gzip      是否gzip压缩文件
+ * @return
+ * 文件长度, 量纲: 字节. 文件不存在时为0
+ * @note
+ * - gzip文件取其尾部记录的原始长度(ISIZE)
+ */
+static size_t source_size(const char *filepath, bool gzip) {
+	struct stat st;
+	if (stat(filepath, &st)) return 0;
+	if (!gzip) return st.st_size;
+
+	unsigned char isize[4];
+	size_t size(0);
+	FILE *fp = fopen(filepath, "rb");
+	if (fp == NULL) return 0;
+	if (!fseek(fp, -4, SEEK_END) && fread(isize, 1, 4, fp) == 4) {
+		size = isize[0] | (isize[1] << 8) | (isize[2] << 16) | (size_t(isize[3]) << 24);
+	}
+	fclose(fp);
+	return size;
+}
+
+/*!
+ * @brief 解析一段星表数据
+ * @param head    首字节
+ * @param tail    尾字节的下一字节
+ * @param maglim  极限星等, 量纲: 0.001星等
+ * @param result  解析结果
+ * @param suppl   true: suppl_x.dat; false: tyc2.dat.xx
  * @return
- * 解析结果
+ * 暗于极限星等而被丢弃的记录数
  * @note
- * - 将坐标转换至J2000
- */
-bool resolve_suppl(const string &line, CatStar &star) {
-	string ra_str   = line.substr(15, 12); trim(ra_str);
-	string dc_str   = line.substr(28, 12); trim(dc_str);
-	string pmra_str = line.substr(41, 7);  trim(pmra_str);
-	string pmdc_str = line.substr(49, 7);  trim(pmdc_str);
-	string bt_str   = line.substr(83, 6);  trim(bt_str);
-	string vt_str   = line.substr(96, 6);  trim(vt_str);
-
-	star.ra  = int(stod(ra_str) * D2MAS);
-	star.spd = int((stod(dc_str) + 90.0) * D2MAS);
-	if (pmra_str.size()) star.pmra = short(stod(pmra_str));
-	if (pmdc_str.size()) star.pmdc = short(stod(pmdc_str));
-	if (bt_str.size() || vt_str.size()) {
-		if (bt_str.size() && vt_str.size()) {
-			double vt = stod(vt_str);
-			star.mag = short((vt - 0.09 * (stod(bt_str) - vt)) * 1000.0);
+ * - 按批次收集行首地址, 由decode_records()批量解码
+ */
+static size_t parse_lines(const char *head, const char *tail, int maglim, StarSink &result,
+		bool suppl = false) {
+	const int szbatch(256);
+	const char *lines[szbatch];
+	int lens[szbatch];
+	CatStar batch[szbatch];
+	char status[szbatch];
+	size_t nfaint(0);
+	const char *p = head;
+	const char *q;
+	int i, n;
+
+	while (p < tail) {
+		for (n = 0; n < szbatch && p < tail; ++n, p = q + 1) {
+			if ((q = (const char*) memchr(p, '\n', tail - p)) == NULL) q = tail;
+			lines[n] = p;
+			lens[n]  = int(q - p);
 		}
-		else {
-			star.mag = short((bt_str.size() ? stod(bt_str) : stod(vt_str)) * 1000.0);
+		decode_records(suppl, lines, lens, n, maglim, batch, status);
+		for (i = 0; i < n; ++i) {
+			if (status[i] == RESOLVE_OK) result.Put(batch[i]);
+			else if (status[i] == RESOLVE_FAINT) ++nfaint;
 		}
+	}
+	return nfaint;
+}
+
+/*!
+ * @brief 流式解压并解析gzip压缩的tyc2.dat.xx
+ * @param filepath  文件路径
+ * @param maglim    极限星等, 量纲: 0.001星等
+ * @param result    解析结果
+ * @param nfaint    暗于极限星等而被丢弃的记录数
+ * @return
+ * 解压是否成功
+ * @note
+ * - 解压数据只在内存缓冲区中按完整行解析, 不落盘
+ * - 整个缓冲区中无换行符时视为文件损坏, 返回false
+ */
+static bool parse_gzip(const char *filepath, int maglim, StarSink &result, size_t &nfaint) {
+	const int szbuff(1 << 20);
+	gzFile gz = gzopen(filepath, "rb");
+	if (gz == NULL) return false;
+
+	vector<char> buff(szbuff);
+	char *head = buff.data();
+	char *end, *last;
+	int nkeep(0), nread;
+	bool overlong(false);
+
+	gzbuffer(gz, 1 << 18);
+	while ((nread = gzread(gz, head + nkeep, szbuff - nkeep)) > 0) {
+		end = head + nkeep + nread;
+		if ((last = (char*) memrchr(head, '\n', end - head)) == NULL) {// 缓冲区内无完整行
+			nkeep += nread;
+			if (nkeep < szbuff) continue;
+			overlong = true;	// 缓冲区已满仍无换行符: 文件已损坏
+			break;
+		}
+		nfaint += parse_lines(head, last + 1, maglim, result);
+		nkeep = int(end - last - 1);
+		memmove(head, last + 1, nkeep);
+	}
+	if (overlong) {
+		gzclose(gz);
+		return false;
+	}
+	if (nkeep > 0) nfaint += parse_lines(head, head + nkeep, maglim, result);
+	gzclose(gz);
+	return nread == 0;
+}
+
+/*!
+ * @brief 执行解析任务
+ * @param task    任务
+ * @param maglim  极限星等, 量纲: 0.001星等
+ */
+static void run_task(ChunkTask &task, int maglim) {
+	if (task.gzpath.empty()) task.nfaint = parse_lines(task.head, task.tail, maglim, task.out);
+	else if (!parse_gzip(task.gzpath.c_str(), maglim, task.out, task.nfaint)) {
+		printf ("failed to decompress %s\n", task.gzpath.c_str());
+	}
+}
+
+/*!
+ * @brief 查找星表文件. 未压缩文件不存在时查找其gzip压缩文件
+ * @param pathroot  根路径
+ * @param name      文件名
+ * @param filepath  文件路径
+ * @param gzip      是否gzip压缩文件
+ * @return
+ * 文件是否存在
+ */
+static bool find_source(const char *pathroot, const char *name, char *filepath, bool &gzip) {
+	struct stat st;
+
+	sprintf (filepath, "%s/%s", pathroot, name);
+	if (!stat(filepath, &st)) {
+		gzip = false;
 		return true;
 	}
-	return false;
+	sprintf (filepath, "%s/%s.gz", pathroot, name);
+	gzip = !stat(filepath, &st);
+	if (!gzip) sprintf (filepath, "%s/%s", pathroot, name);
+	return gzip;
 }
 
-void to_J2000(ATimeSpace& ats, CatStar& star) {
-	double ra, dc;
-	double t = 2000.0 - ats.Epoch();
-	ra = (star.ra + star.pmra * t / cos((star.spd * MAS2D - 90.0) * D2R)) * MAS2D;
-	dc = (star.spd + star.pmdc * t) * MAS2D - 90.0;
-	ats.EqReTransfer(ra * D2R, dc * D2R, ra, dc);
-	star.ra  = int(ra * R2D * D2MAS);
-	star.spd = int((dc * R2D + 90.0) * D2MAS);
+/*!
+ * @brief 将文件按记录边界分割为并行任务
+ * @param mf     内存映射文件
+ * @param nchunk 期望的分段数
+ * @param tasks  任务队列
+ */
+static void split_chunks(const MappedFile &mf, int nchunk, vector<ChunkTask> &tasks) {
+	const char *head = mf.data;
+	const char *end  = mf.data + mf.size;
+	size_t step = mf.size / nchunk + 1;
+
+	while (head < end) {
+		const char *tail = head + step < end ? head + step : end;
+		if (tail < end) {// 对齐至下一行首
+			const char *q = (const char*) memchr(tail, '\n', end - tail);
+			tail = q ? q + 1 : end;
+		}
+		tasks.push_back(ChunkTask());
+		tasks.back().head = head;
+		tasks.back().tail = tail;
+		head = tail;
+	}
 }
 
-void load_catalog(const char *pathroot) {
+/*!
+ * @brief 逐行读取并解析tyc2.dat.xx
+ * @param pathroot  根路径
+ * @param maglim    极限星等, 量纲: 0.001星等
+ * @return
+ * 暗于极限星等而被丢弃的记录数
+ * @note
+ * - zlib透明读取未压缩文件和gzip压缩文件
+ */
+static size_t load_cat_serial(StarTable &table, const char *pathroot, int maglim) {
 	const int szline(220);
-	char filepath[50], line[szline];
+	char name[20], filepath[256], line[szline];
+	size_t nfaint(0);
+	bool gzip;
 
 	for (int i = 0; i < 20; ++i) {
-		sprintf (filepath, "%s/tyc2.dat.%02d", pathroot, i);
+		sprintf (name, "tyc2.dat.%02d", i);
+		find_source(pathroot, name, filepath, gzip);
 		printf ("%s\n", filepath);
 
-		FILE *fp = fopen(filepath, "r");
-		while (!feof(fp)) {
-			if (NULL == fgets(line, szline, fp)) continue;
-
+		gzFile gz = gzopen(filepath, "rb");
+		if (gz == NULL) {
+			printf ("failed to open %s\n", filepath);
+			continue;
+		}
+		while (gzgets(gz, line, szline)) {
 			CatStar star;
-			if (resolve_cat(line, star)) stars.push_back(star);
+			int rslt = resolve_cat(line, strlen(line), star, maglim);
+			if (rslt == RESOLVE_OK) table.Append(star);
+			else if (rslt == RESOLVE_FAINT) ++nfaint;
 		}
-		fclose(fp);
+		gzclose(gz);
+	}
+	return nfaint;
+}
+
+/*!
+ * @brief 内存映射并多线程解析tyc2.dat.xx
+ * @param pathroot  根路径
+ * @param maglim    极限星等, 量纲: 0.001星等
+ * @param nthread   线程数
+ * @param nextra    为后续加载的星额外预留的星数
+ * @return
+ * 暗于极限星等而被丢弃的记录数
+ * @note
+ * - 未压缩文件被内存映射后分段解析; gzip压缩文件各自由一个线程流式解压并解析
+ * - 每个任务在星表中预留一个区间, 长度为其数据量按定长记录(TYC2_RECLEN)计的记录数, 超出的记录
+ *   暂存于溢出区. 星表存储区不初始化, 未写入的预留区不占用物理内存
+ * - 各任务结束后, 按文件序号与段序号在原位压紧, 与逐行解析结果一致
+ */
+static size_t load_cat_mapped(StarTable &table, const char *pathroot, int maglim, int nthread,
+		size_t nextra) {
+	const int nfile(20);
+	const int nchunk(nthread * 4);	// 每个文件的分段数, 平衡各线程负载
+	char name[20], filepath[256];
+	MappedFile mf[nfile];
+	vector<ChunkTask> tasks;
+	vector<int> order;	// 执行顺序: 耗时较长的解压任务优先
+	vector<thread> workers;
+	atomic<int> next(0);
+	size_t i, n, nfaint(0);
+	bool gzip;
+
+	for (i = 0; i < nfile; ++i) {
+		sprintf (name, "tyc2.dat.%02d", int(i));
+		if (!find_source(pathroot, name, filepath, gzip)) {
+			printf ("failed to find %s\n", filepath);
+		}
+		else if (gzip) {
+			printf ("%s\n", filepath);
+			tasks.push_back(ChunkTask());
+			tasks.back().gzpath = filepath;
+		}
+		else if (!mf[i].Map(filepath)) printf ("failed to map %s\n", filepath);
+		else {
+			printf ("%s\n", filepath);
+			split_chunks(mf[i], nchunk, tasks);
+		}
+	}
+	size_t n0 = table.Size();
+	for (i = 0, n = n0; i < tasks.size(); ++i) {
+		ChunkTask &task = tasks[i];
+		size_t size = task.gzpath.empty() ? task.tail - task.head : source_size(task.gzpath.c_str(), true);
+		task.out.table    = &table;
+		task.out.first    = n;
+		task.out.capacity = (size + TYC2_RECLEN - 1) / TYC2_RECLEN;
+		n += task.out.capacity;
+	}
+	table.Reserve(n + nextra);
+	table.Resize(n);
+	for (i = 0; i < tasks.size(); ++i) {
+		if (!tasks[i].gzpath.empty()) order.push_back(int(i));
+	}
+	for (i = 0; i < tasks.size(); ++i) {
+		if (tasks[i].gzpath.empty()) order.push_back(int(i));
+	}
+
+	for (int j = 0; j < nthread; ++j) {
+		workers.push_back(thread([&tasks, &order, &next, maglim]() {
+			int k;
+			while ((k = next++) < int(order.size())) run_task(tasks[order[k]], maglim);
+		}));
+	}
+	for (i = 0; i < workers.size(); ++i) workers[i].join();
+
+	vector<size_t> ends(tasks.size());	// 压紧后各任务结果的尾序号
+	for (i = 0, n = n0; i < tasks.size(); ++i) {
+		table.Move(tasks[i].out.first, tasks[i].out.count, n);
+		ends[i] = n += tasks[i].out.count;
+		nfaint += tasks[i].nfaint;
 	}
+	table.Resize(n);
+	for (i = tasks.size(); i-- > 0; ) {// 预留区间不足时的溢出部分
+		const CatStarVec &spill = tasks[i].out.spill;
+		if (spill.size()) table.Insert(ends[i], spill.data(), spill.size());
+	}
+	return nfaint;
+}
 
+/*!
+ * @brief 逐行读取并解析补充星表, 转换至J2000
+ * @param pathroot  根路径
+ * @param maglim    极限星等, 量纲: 0.001星等
+ * @return
+ * 暗于极限星等而被丢弃的记录数
+ */
+static size_t load_suppl_serial(StarTable &table, const char *pathroot, int maglim) {
+	const int szline(220);
+	char name[20], filepath[256], line[szline];
+	size_t nfaint(0);
+	bool gzip;
 	ATimeSpace ats;
 	ats.SetEpoch(1991.25);
 
 	for (int i = 1; i <= 2; ++i) {
-		sprintf (filepath, "%s/suppl_%d.dat", pathroot, i);
+		sprintf (name, "suppl_%d.dat", i);
+		find_source(pathroot, name, filepath, gzip);
 		printf ("%s\n", filepath);
 
-		FILE *fp = fopen(filepath, "r");
-		while (!feof(fp)) {
-			if (NULL == fgets(line, szline, fp)) continue;
-
+		gzFile gz = gzopen(filepath, "rb");
+		if (gz == NULL) {
+			printf ("failed to open %s\n", filepath);
+			continue;
+		}
+		while (gzgets(gz, line, szline)) {
 			CatStar star;
-			if (resolve_suppl(line, star)) {
+			int rslt = resolve_suppl(line, strlen(line), star, maglim);
+			if (rslt == RESOLVE_OK) {
 				to_J2000(ats, star);
-				stars.push_back(star);
+				table.Append(star);
 			}
+			else if (rslt == RESOLVE_FAINT) ++nfaint;
 		}
-		fclose(fp);
+		gzclose(gz);
 	}
+	return nfaint;
 }
 
-void sort_catalog() {
-	sort(stars.begin(), stars.end(), [](CatStar& x1, CatStar& x2) {
-		double scale = 0.4 * MAS2D;
-		int id1 = int(x1.spd * scale);
-		int id2 = int(x2.spd * scale);
-		int ir1 = int(x1.ra * scale);
-		int ir2 = int(x2.ra * scale);
-		return (id1 < id2 || (id1 == id2 && ir1 < ir2));
+/*!
+ * @struct TextBatch 由若干完整行构成的原始数据块
+ */
+struct TextBatch {
+	vector<char> text;
+};
+
+/*!
+ * @struct StarBatch 一批星数据
+ */
+struct StarBatch {
+	StarSink stars;
+};
+
+/*!
+ * @brief 以流水线读取、解析补充星表并转换至J2000
+ * @param pathroot  根路径
+ * @param maglim    极限星等, 量纲: 0.001星等
+ * @return
+ * 暗于极限星等而被丢弃的记录数
+ * @note
+ * - 读取、解析、历元转换各由一个线程执行, 当前线程追加结果
+ * - 暗星在解析阶段即被丢弃, 不进入历元转换
+ * - 相邻阶段间以有界无锁队列传递批次, 空指针表示数据结束
+ * - 各阶段均按序处理, 星表中的顺序与逐行处理一致
+ * - 解压出错时报告错误, 并放弃该文件的剩余部分
+ */
+static size_t load_suppl_pipeline(StarTable &table, const char *pathroot, int maglim) {
+	const size_t szqueue(8);
+	size_t nfaint(0);
+	SpscQueue<TextBatch*> texts(szqueue);
+	SpscQueue<StarBatch*> parsed(szqueue);
+	SpscQueue<StarBatch*> converted(szqueue);
+
+	thread reader([pathroot, &texts]() {
+		const int szblock(1 << 18);
+		char name[20], filepath[256];
+		vector<char> rest;
+		bool gzip;
+		int nread;
+
+		for (int i = 1; i <= 2; ++i) {
+			sprintf (name, "suppl_%d.dat", i);
+			find_source(pathroot, name, filepath, gzip);
+			printf ("%s\n", filepath);
+
+			gzFile gz = gzopen(filepath, "rb");
+			if (gz == NULL) {
+				printf ("failed to open %s\n", filepath);
+				continue;
+			}
+			rest.clear();
+			do {
+				TextBatch *batch = new TextBatch;
+				batch->text.swap(rest);
+				size_t n0 = batch->text.size();
+				batch->text.resize(n0 + szblock);
+				nread = gzread(gz, batch->text.data() + n0, szblock);
+				if (nread < 0) {// 解压失败: 丢弃不完整的末行, 不再读取该文件
+					int errnum;
+					printf ("failed to decompress %s\n", gzerror(gz, &errnum));	// 错误信息含文件路径
+					delete batch;
+					break;
+				}
+				batch->text.resize(n0 + nread);
+				if (nread > 0) {// 不完整的末行留待下一块
+					vector<char>::iterator last = find(batch->text.rbegin(), batch->text.rend(), '\n').base();
+					rest.assign(last, batch->text.end());
+					batch->text.erase(last, batch->text.end());
+				}
+				if (batch->text.empty()) delete batch;
+				else texts.Push(batch);
+			} while (nread > 0);
+			gzclose(gz);
+		}
+		texts.Push(NULL);
 	});
+
+	thread parser([&texts, &parsed, &nfaint, maglim]() {
+		TextBatch *text;
+		while ((text = texts.Pop()) != NULL) {
+			StarBatch *batch = new StarBatch;
+			nfaint += parse_lines(text->text.data(), text->text.data() + text->text.size(), maglim,
+					batch->stars, true);
+			delete text;
+			parsed.Push(batch);
+		}
+		parsed.Push(NULL);
+	});
+
+	thread transformer([&parsed, &converted]() {
+		ATimeSpace ats;
+		StarBatch *batch;
+
+		ats.SetEpoch(1991.25);
+		while ((batch = parsed.Pop()) != NULL) {
+			to_J2000(ats, batch->stars.spill.data(), int(batch->stars.spill.size()));
+			converted.Push(batch);
+		}
+		converted.Push(NULL);
+	});
+
+	StarBatch *batch;
+	while ((batch = converted.Pop()) != NULL) {
+		table.Append(batch->stars.spill.data(), batch->stars.spill.size());
+		delete batch;
+	}
+	reader.join();
+	parser.join();
+	transformer.join();
+	return nfaint;
+}
+
+/*!
+ * @brief 将极限星等转换为0.001星等
+ */
+static int mag_limit(double maglim) {
+	return maglim * 1000.0 < INT_MAX ? int(maglim * 1000.0 + 0.5) : INT_MAX;
+}
+
+/*!
+ * @brief 依据文件长度估计星表记录数
+ * @param pathroot  根路径
+ * @param ncat      tyc2.dat.xx的记录数
+ * @param nsuppl    suppl_x.dat的记录数
+ */
+static void estimate_records(const char *pathroot, size_t &ncat, size_t &nsuppl) {
+	char name[20], filepath[256];
+	bool gzip;
+	int i;
+
+	for (i = 0, ncat = 0; i < 20; ++i) {
+		sprintf (name, "tyc2.dat.%02d", i);
+		find_source(pathroot, name, filepath, gzip);
+		ncat += source_size(filepath, gzip) / TYC2_RECLEN;
+	}
+	for (i = 1, nsuppl = 0; i <= 2; ++i) {
+		sprintf (name, "suppl_%d.dat", i);
+		find_source(pathroot, name, filepath, gzip);
+		nsuppl += source_size(filepath, gzip) / SUPPL_RECLEN;
+	}
+}
+
+void load_catalog(StarTable &table, const char *pathroot, double maglim, int nthread) {
+	int mlim = mag_limit(maglim);
+	size_t n0 = table.Size();
+	size_t nfaint, ncat, nsuppl;
+
+	estimate_records(pathroot, ncat, nsuppl);
+	if (nthread <= 0) nthread = thread::hardware_concurrency();
+	if (nthread <= 1) {
+		table.Reserve(n0 + ncat + nsuppl);
+		nfaint  = load_cat_serial(table, pathroot, mlim);
+		nfaint += load_suppl_serial(table, pathroot, mlim);
+	}
+	else {
+		nfaint  = load_cat_mapped(table, pathroot, mlim, nthread, nsuppl);
+		nfaint += load_suppl_pipeline(table, pathroot, mlim);
+	}
+	table.UpdateVectors(n0);
+	printf ("%zu stars loaded, %zu stars fainter than %.2f skipped\n", table.Size() - n0, nfaint, maglim);
+}
+
+/*!
+ * @struct SourceStamp 原始星表文件的标识
+ */
+struct SourceStamp {
+	int64_t size;	//< 文件长度, 量纲: 字节. -1: 文件不存在
+	int64_t mtime;	//< 修改时间
+};
+
+/*!
+ * @struct CacheHeader 星表缓存文件头
+ * @note
+ * - 文件结构: 文件头 + 各列数组, 依次为ra、spd、pmra、pmdc、mag、x、y、z.
+ *   文件头与各列长度均补零至64字节的整数倍, 各列起始位置按64字节对齐
+ */
+struct CacheHeader {
+	char magic[8];			//< 文件标志
+	uint32_t version;		//< 格式版本
+	int32_t maglim;			//< 极限星等, 量纲: 0.001星等
+	int32_t scheme;			//< 天区划分方案
+	int32_t reserved;		//< 保留
+	uint64_t count;			//< 星数
+	SourceStamp sources[22];	//< tyc2.dat.00~19, suppl_1~2.dat
+};
+
+#define CACHE_MAGIC		"TYC2CAT"
+#define CACHE_VERSION	4
+#define CACHE_ALIGN		64
+
+static_assert(sizeof(CacheHeader) % CACHE_ALIGN == 0, "cache header must keep the columns aligned");
+
+/*!
+ * @brief 生成缓存文件头
+ * @param pathroot  根路径
+ * @param maglim    极限星等, 量纲: 0.001星等
+ * @param scheme    天区划分方案
+ * @param header    文件头
+ * @param cachepath 缓存文件路径
+ */
+static void make_cache_header(const char *pathroot, int maglim, int scheme, CacheHeader &header,
+		char *cachepath) {
+	char name[20], filepath[256];
+	struct stat st;
+	bool gzip;
+
+	memset(&header, 0, sizeof(CacheHeader));
+	memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+	header.version = CACHE_VERSION;
+	header.maglim  = maglim;
+	header.scheme  = scheme;
+	for (int i = 0; i < 22; ++i) {
+		if (i < 20) sprintf (name, "tyc2.dat.%02d", i);
+		else sprintf (name, "suppl_%d.dat", i - 19);
+		if (find_source(pathroot, name, filepath, gzip) && !stat(filepath, &st)) {
+			header.sources[i].size  = st.st_size;
+			header.sources[i].mtime = st.st_mtime;
+		}
+		else header.sources[i].size = -1;
+	}
+	if (scheme == SKY_HEALPIX) sprintf (cachepath, "%s/tycho2_M%d_hpx.cache", pathroot, maglim);
+	else if (scheme == SKY_HILBERT) sprintf (cachepath, "%s/tycho2_M%d_hil.cache", pathroot, maglim);
+	else sprintf (cachepath, "%s/tycho2_M%d.cache", pathroot, maglim);
+}
+
+/*!
+ * @brief 一列在缓存文件中占用的字节数, 含对齐补零
+ */
+static uint64_t cache_column_size(uint64_t n, size_t size) {
+	return (n * size + CACHE_ALIGN - 1) / CACHE_ALIGN * CACHE_ALIGN;
+}
+
+/*!
+ * @brief 缓存文件的长度, 量纲: 字节
+ */
+static uint64_t cache_file_size(uint64_t n) {
+	return sizeof(CacheHeader) + cache_column_size(n, sizeof(int32_t)) * 2
+			+ cache_column_size(n, sizeof(int16_t)) * 3 + cache_column_size(n, sizeof(double)) * 3;
+}
+
+/*!
+ * @brief 由缓存数据复制一列
+ * @param ptr  数据指针, 按64字节对齐. 复制后指向下一列
+ * @param n    元素数
+ * @param col  列
+ */
+template <class C>
+static void read_column(const char *&ptr, size_t n, C &col) {
+	typedef typename C::value_type T;
+	col.resize(n);
+	memcpy(col.data(), ptr, n * sizeof(T));
+	ptr += cache_column_size(n, sizeof(T));
+}
+
+/*!
+ * @brief 写入一列, 并在其后补零至对齐位置
+ * @return
+ * 写入结果
+ */
+template <class C>
+static bool write_column(FILE *fp, const C &col) {
+	static const char zeros[CACHE_ALIGN] = { 0 };
+	size_t size = sizeof(typename C::value_type);
+	size_t npad = size_t(cache_column_size(col.size(), size) - col.size() * size);
+	return fwrite(col.data(), size, col.size(), fp) == col.size() && fwrite(zeros, 1, npad, fp) == npad;
+}
+
+bool load_cache(StarTable &table, const char *pathroot, double maglim, int scheme) {
+	char filepath[256];
+	CacheHeader header;
+	MappedFile mf;
+
+	make_cache_header(pathroot, mag_limit(maglim), scheme, header, filepath);
+	if (!mf.Map(filepath) || mf.size < sizeof(CacheHeader)) return false;
+
+	const CacheHeader *hdr = (const CacheHeader*) mf.data;
+	if (memcmp(hdr->magic, header.magic, sizeof(header.magic))
+			|| hdr->version != header.version
+			|| hdr->maglim != header.maglim
+			|| hdr->scheme != header.scheme
+			|| memcmp(hdr->sources, header.sources, sizeof(header.sources))
+			|| hdr->count > mf.size || mf.size != cache_file_size(hdr->count)) {
+		printf ("%s is out of date\n", filepath);
+		return false;
+	}
+	const char *ptr = mf.data + sizeof(CacheHeader);
+	size_t n = hdr->count;
+	read_column(ptr, n, table.ra);
+	read_column(ptr, n, table.spd);
+	read_column(ptr, n, table.pmra);
+	read_column(ptr, n, table.pmdc);
+	read_column(ptr, n, table.mag);
+	read_column(ptr, n, table.x);
+	read_column(ptr, n, table.y);
+	read_column(ptr, n, table.z);
+	printf ("%zu stars loaded from %s\n", table.Size(), filepath);
+	return true;
+}
+
+bool save_cache(const StarTable &table, const char *pathroot, double maglim, int scheme) {
+	char filepath[256], tmppath[260];
+	CacheHeader header;
+	FILE *fp;
+	bool rslt;
+
+	make_cache_header(pathroot, mag_limit(maglim), scheme, header, filepath);
+	header.count = table.Size();
+	sprintf (tmppath, "%s.tmp", filepath);
+	if ((fp = fopen(tmppath, "wb")) == NULL) {
+		printf ("failed to create %s\n", tmppath);
+		return false;
+	}
+	rslt = fwrite(&header, sizeof(CacheHeader), 1, fp) == 1
+			&& write_column(fp, table.ra) && write_column(fp, table.spd)
+			&& write_column(fp, table.pmra) && write_column(fp, table.pmdc)
+			&& write_column(fp, table.mag)
+			&& write_column(fp, table.x) && write_column(fp, table.y) && write_column(fp, table.z);
+	rslt = !fclose(fp) && rslt && !rename(tmppath, filepath);
+	if (!rslt) {
+		printf ("failed to write %s\n", filepath);
+		remove(tmppath);
+	}
+	return rslt;
+}
+
+/*!
+ * @struct SortKey 排序键值与星序号
+ */
+struct SortKey {
+	uint64_t key;	//< 分区与分区内位置
+	uint32_t index;	//< 星序号
+
+public:
+	bool operator<(const SortKey &x) const {
+		return key < x.key || (key == x.key && index < x.index);
+	}
+};
+typedef vector<SortKey> SortKeyVec;
+
+/*!
+ * @brief 生成赤经赤纬分区的排序键值
+ * @param table  星表
+ * @param keys   键值
+ * @note
+ * - 键值共62位: 分区序号(14位) | 分区内赤经偏移(24位) | 分区内赤纬偏移(24位)
+ * - 分区序号由grid_cell()计算, 与分区索引文件一致
+ */
+static void make_grid_keys(const StarTable &table, SortKeyVec &keys) {
+	size_t n = table.Size();
+	uint32_t ra_off, spd_off;
+
+	keys.resize(n);
+	for (size_t i = 0; i < n; ++i) {
+		uint64_t zone = grid_cell(table.ra[i], table.spd[i], ra_off, spd_off);
+		keys[i].key   = (zone << 48) | (uint64_t(ra_off) << 24) | spd_off;
+		keys[i].index = uint32_t(i);
+	}
+}
+
+/*!
+ * @brief 生成HEALPix分区的排序键值
+ * @param table    星表
+ * @param keys     键值
+ * @param nthread  线程数
+ * @note
+ * - 键值为单位矢量在最高阶(Nside=2^29)的NESTED像元序号, 不超过62位.
+ *   其高位即为任意低阶的像元序号, 因此排序结果与Nside无关
+ * - 各线程计算连续的一段星
+ */
+static void make_healpix_keys(const StarTable &table, SortKeyVec &keys, int nthread) {
+	HEALPix hp(int64_t(1) << HEALPix::MAX_ORDER);
+	size_t n = table.Size();
+
+	keys.resize(n);
+	run_threads(nthread, [&table, &keys, &hp, n, nthread](int t) {
+		for (size_t i = n * t / nthread; i < n * (t + 1) / nthread; ++i) {
+			keys[i].key   = uint64_t(hp.Vec2Pix(table.x[i], table.y[i], table.z[i]));
+			keys[i].index = uint32_t(i);
+		}
+	});
+}
+
+/*!
+ * @brief 多线程归并排序
+ * @param keys     待排序数据
+ * @param nthread  线程数
+ * @note
+ * - 各线程先对一段数据调用std::sort(), 再逐轮两两归并, 每轮的各次归并并行执行
+ */
+static void merge_sort(SortKeyVec &keys, int nthread) {
+	const size_t minblock(1 << 16);	// 每段的最少元素数
+	size_t n = keys.size();
+	int nblock(1), width;
+
+	while (nblock * 2 <= nthread && n / (nblock * 2) >= minblock) nblock *= 2;
+	vector<size_t> bound(nblock + 1);
+	for (int b = 0; b <= nblock; ++b) bound[b] = n * b / nblock;
+
+	run_threads(nblock, [&keys, &bound](int b) {
+		sort(keys.begin() + bound[b], keys.begin() + bound[b + 1]);
+	});
+	if (nblock == 1) return;
+
+	SortKeyVec buff(n);
+	SortKey *src = keys.data();
+	SortKey *dst = buff.data();
+	for (width = 1; width < nblock; width *= 2) {
+		run_threads(nblock / (2 * width), [src, dst, &bound, width](int t) {
+			int b = t * 2 * width;
+			size_t i0 = bound[b], i1 = bound[b + width], i2 = bound[b + 2 * width];
+			merge(src + i0, src + i1, src + i1, src + i2, dst + i0);
+		});
+		swap(src, dst);
+	}
+	if (src != keys.data()) keys.swap(buff);
+}
+
+/*!
+ * @brief 多线程LSD基数排序
+ * @param keys     待排序数据
+ * @param nthread  线程数
+ * @note
+ * - 每轮处理键值的16位, 4轮覆盖62位键值
+ * - 每轮各线程统计其数据段的直方图, 由全部直方图计算各线程在各桶中的写入位置,
+ *   再各自分发其数据段. 分发保持各桶内的原顺序, 因此排序稳定
+ * - 全部键值落入同一桶的轮次被跳过
+ */
+static void radix_sort(SortKeyVec &keys, int nthread) {
+	const int nbit(16), nbucket(1 << nbit), keybits(62);
+	const uint64_t mask(nbucket - 1);
+	const size_t minblock(1 << 16);	// 每个线程的最少元素数
+	size_t n = keys.size();
+
+	if (nthread < 1) nthread = 1;
+	if (size_t(nthread) > n / minblock) nthread = n / minblock > 0 ? int(n / minblock) : 1;
+	vector<size_t> bound(nthread + 1);
+	vector< vector<size_t> > offset(nthread, vector<size_t>(nbucket));
+	for (int t = 0; t <= nthread; ++t) bound[t] = n * t / nthread;
+
+	SortKeyVec buff(n);
+	SortKey *src = keys.data();
+	SortKey *dst = buff.data();
+	for (int shift = 0; shift < keybits; shift += nbit) {
+		run_threads(nthread, [src, &bound, &offset, shift, mask](int t) {
+			vector<size_t> &count = offset[t];
+			fill(count.begin(), count.end(), 0);
+			for (size_t i = bound[t]; i < bound[t + 1]; ++i) ++count[(src[i].key >> shift) & mask];
+		});
+
+		size_t pos(0), total;
+		bool skip(false);
+		for (int d = 0; d < nbucket; ++d) {
+			for (int t = total = 0; t < nthread; ++t) total += offset[t][d];
+			if (total == n) skip = true;
+			for (int t = 0; t < nthread; ++t) {
+				size_t c = offset[t][d];
+				offset[t][d] = pos;
+				pos += c;
+			}
+		}
+		if (skip) continue;
+
+		run_threads(nthread, [src, dst, &bound, &offset, shift, mask](int t) {
+			vector<size_t> &pos = offset[t];
+			for (size_t i = bound[t]; i < bound[t + 1]; ++i) dst[pos[(src[i].key >> shift) & mask]++] = src[i];
+		});
+		swap(src, dst);
+	}
+	if (src != keys.data()) keys.swap(buff);
+}
+
+/*!
+ * @brief 生成HEALPix分区的Hilbert曲线排序键值
+ * @param table  星表
+ * @param keys   键值
+ * @note
+ * - 键值为最高阶像元的面序号与面内Hilbert序号, 不超过62位.
+ *   其高位即为任意低阶像元的Hilbert序号, 同一像元的星连续
+ */
+static void make_hilbert_keys(const StarTable &table, SortKeyVec &keys, int nthread) {
+	HEALPix hp(int64_t(1) << HEALPix::MAX_ORDER);
+	size_t n = table.Size();
+
+	keys.resize(n);
+	run_threads(nthread, [&table, &keys, &hp, n, nthread](int t) {
+		for (size_t i = n * t / nthread; i < n * (t + 1) / nthread; ++i) {
+			keys[i].key   = uint64_t(hp.Nest2Hilbert(hp.Vec2Pix(table.x[i], table.y[i], table.z[i])));
+			keys[i].index = uint32_t(i);
+		}
+	});
+}
+
+void sort_catalog(StarTable &table, int nthread, int method, int scheme) {
+	size_t i, n = table.Size();
+	SortKeyVec keys;
+	StarTable::IndexVec index(n);
+
+	if (nthread <= 0) nthread = thread::hardware_concurrency();
+	if (nthread < 1) nthread = 1;
+	if (scheme == SKY_HEALPIX) make_healpix_keys(table, keys, nthread);
+	else if (scheme == SKY_HILBERT) make_hilbert_keys(table, keys, nthread);
+	else make_grid_keys(table, keys);
+	if (method == SORT_MERGE) merge_sort(keys, nthread);
+	else radix_sort(keys, nthread);
+	for (i = 0; i < n; ++i) index[i] = keys[i].index;
+	table.Permute(index);
+}
+
+string index_path(const char *pathroot, double maglim, int scheme, int nside, double fov, int nstar, bool codes) {
+	char filepath[256];
+	int n = sprintf (filepath, "%s/tycho2_M%g", pathroot, maglim);
+
+	if (healpix_scheme(scheme)) n += sprintf (filepath + n, "_H%d%s", nside, scheme == SKY_HILBERT ? "h" : "");
+	if (fov > 0.0) n += sprintf (filepath + n, "_F%g_N%d%s", fov, nstar, codes ? "_codes" : "");
+	sprintf (filepath + n, ".dat");
+	return string(filepath);
+}
+
+void assign_pixels(const StarTable &table, const HEALPix &hp, vector<int64_t> &pix) {
+	size_t n = table.Size();
+
+	pix.resize(n);
+	for (size_t i = 0; i < n; ++i) pix[i] = hp.Vec2Pix(table.x[i], table.y[i], table.z[i]);
+}
+
+void pixel_ranges(const StarTable &table, const HEALPix &hp, vector<uint32_t> &head) {
+	size_t i, n = table.Size();
+	int64_t p, npix = hp.Npix();
+	vector<int64_t> pix;
+
+	assign_pixels(table, hp, pix);
+	head.assign(npix + 1, 0);
+	for (i = 0; i < n; ++i) ++head[pix[i] + 1];
+	for (p = 0; p < npix; ++p) head[p + 1] += head[p];
 }
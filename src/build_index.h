@@ -7,52 +7,185 @@
 
 #include <string>
 #include <vector>
+#include <limits.h>
 #include <string.h>
 #include "ATimeSpace.h"
 
+/*!
+ * @struct CatStar 一颗星的行记录
+ * @note
+ * - 不初始化. 解析结果为RESOLVE_OK时各字段均已赋值
+ */
 struct CatStar {
 	int ra, spd;		// J2000坐标, 量纲: 毫角秒
 	short pmra, pmdc;	// 自行, 量纲: 毫角秒/年
 	short mag;			// 0.001星等
-
-public:
-	CatStar() {
-		memset(this, 0, sizeof(CatStar));
-	}
 };
 typedef std::vector<CatStar> CatStarVec;
-extern CatStarVec stars;
+
+#define CATALOG_EPOCH	2000.0	//< 星表坐标与单位矢量的历元
+
+class StarTable;
+class HEALPix;
+
+/*!
+ * @brief 记录解析结果
+ */
+enum {
+	RESOLVE_INVALID,	//< 无效记录: 缺少坐标或星等
+	RESOLVE_OK,			//< 有效记录
+	RESOLVE_FAINT		//< 暗于极限星等, 已丢弃
+};
 
 /*!
  * @brief 解析Tycho2中tyc2.dat.xx
- * @param line 一行数据
+ * @param line    一行数据
+ * @param len     数据长度
+ * @param star    星数据
+ * @param maglim  极限星等, 量纲: 0.001星等
  * @return
  * 解析结果
+ * @note
+ * - 直接由定宽列解码数值, 不分配内存
+ * - 先解码星等, 暗于极限星等时不再解码位置与自行
  */
-bool resolve_cat(const std::string &line, CatStar &star);
+int resolve_cat(const char *line, int len, CatStar &star, int maglim = INT_MAX);
 /*!
  * @brief 解析Tycho2的补充星表
- * @param line 一行数据
+ * @param line    一行数据
+ * @param len     数据长度
+ * @param star    星数据
+ * @param maglim  极限星等, 量纲: 0.001星等
  * @return
  * 解析结果
  * @note
- * - 将坐标转换至J2000
+ * - 坐标历元为J1991.25, 需调用to_J2000()转换至J2000
  */
-bool resolve_suppl(const std::string &line, CatStar &star);
+int resolve_suppl(const char *line, int len, CatStar &star, int maglim = INT_MAX);
 /*!
  * @brief 赤道坐标历元转换: J1991.25=>J2000
  * @param ats   算法接口
  * @param star  星数据
  */
 void to_J2000(AstroUtil::ATimeSpace& ats, CatStar& star);
+/*!
+ * @brief 批量赤道坐标历元转换: J1991.25=>J2000
+ * @param ats   算法接口
+ * @param star  星数据
+ * @param n     星数
+ * @note
+ * - 调用ATimeSpace::EqReTransfer()的批量接口, 历元相关的项只计算一次
+ */
+void to_J2000(AstroUtil::ATimeSpace& ats, CatStar* star, int n);
 /*!
  * @brief 加载原始星表
+ * @param table     星表. 新加载的星追加在末尾
  * @param pathroot  根路径
+ * @param maglim    极限星等. 暗于该星等的记录在解析星等后即被丢弃
+ * @param nthread   线程数. 0: 使用全部CPU核; 1: 逐行读取
+ * @note
+ * - 多线程时内存映射各文件, 按记录边界分段并行解析, 再依文件与分段顺序合并,
+ *   结果与逐行读取一致
+ * - 未压缩文件不存在时, 读取CDS发布的gzip压缩文件(*.gz), 流式解压, 不落盘
+ * - 多线程时补充星表由读取、解析、历元转换三级流水线处理
+ * - 加载前依据文件长度与记录长度估计星数, 一次性分配星表存储区
+ * - 多线程时各任务直接写入星表中预留的互不重叠区间, 结束后在原位压紧
+ * - 加载完成后计算单位矢量
+ */
+void load_catalog(StarTable &table, const char *pathroot, double maglim = 99.0, int nthread = 0);
+/*!
+ * @brief 星表排序算法
  */
-void load_catalog(const char *pathroot);
+enum {
+	SORT_MERGE,	//< 多线程归并排序
+	SORT_RADIX	//< 多线程LSD基数排序
+};
+
 /*!
- * @brief 星表依据赤纬和赤经增量排序
+ * @brief 天区划分方案
+ */
+enum {
+	SKY_GRID,		//< 赤经、赤纬各2.5度的分区
+	SKY_HEALPIX,	//< HEALPix NESTED像元, 星按NESTED序号(面内Morton曲线)排列
+	SKY_HILBERT		//< HEALPix NESTED像元, 星按面内Hilbert曲线排列
+};
+
+/*!
+ * @brief 天区划分方案是否为HEALPix像元
+ */
+inline bool healpix_scheme(int scheme) {
+	return scheme == SKY_HEALPIX || scheme == SKY_HILBERT;
+}
+
+/*!
+ * @brief 星表依据天区分区排序
+ * @param table    星表
+ * @param nthread  线程数. 0: 使用全部CPU核
+ * @param method   排序算法
+ * @param scheme   天区划分方案
+ * @note
+ * - SKY_GRID: 星表按2.5度x2.5度分区, 依次按分区序号、分区内赤经、分区内赤纬排序
+ * - SKY_HEALPIX: 星表按最高阶NESTED像元序号排序, 对任意Nside都是按像元排序,
+ *   同一像元的星在存储区中连续
+ * - SKY_HILBERT: 星表按最高阶像元的面内Hilbert序号排序. 对任意Nside, 同一像元的星
+ *   仍然连续, 且曲线上相邻的像元在天球上相邻, 邻域检索时访存更集中
+ * - 每颗星的键值一次性打包为62位整数, 与星序号一同排序, 再由StarTable::Permute()重排各列
+ * - 键值相同的星保持原顺序, 两种排序算法的结果一致
+ */
+void sort_catalog(StarTable &table, int nthread = 0, int method = SORT_RADIX, int scheme = SKY_GRID);
+/*!
+ * @brief 计算各星所在的HEALPix像元
+ * @param table  星表
+ * @param hp     HEALPix划分
+ * @param pix    各星的像元序号
+ */
+void assign_pixels(const StarTable &table, const HEALPix &hp, std::vector<int64_t> &pix);
+/*!
+ * @brief 统计已按SKY_HEALPIX排序的星表中各像元的星序号区间
+ * @param table  星表
+ * @param hp     HEALPix划分
+ * @param head   像元p的星序号区间为[head[p], head[p+1]), 长度为Npix+1
+ */
+void pixel_ranges(const StarTable &table, const HEALPix &hp, std::vector<uint32_t> &head);
+/*!
+ * @brief 由缓存文件加载已转换至J2000并排序的星表
+ * @param table     星表
+ * @param pathroot  根路径
+ * @param maglim    极限星等
+ * @param scheme    天区划分方案, 即星表的排序方式
+ * @return
+ * 缓存是否有效
+ * @note
+ * - 缓存文件为pathroot/tycho2_M<极限星等, 量纲: 0.001星等>.cache,
+ *   SKY_HEALPIX时为pathroot/tycho2_M<极限星等>_hpx.cache, SKY_HILBERT时为_hil.cache
+ * - 当格式版本、极限星等、划分方案或原始星表文件的长度与修改时间不一致时, 缓存失效
+ */
+bool load_cache(StarTable &table, const char *pathroot, double maglim, int scheme = SKY_GRID);
+/*!
+ * @brief 将已排序的星表存储为缓存文件
+ * @param table     星表
+ * @param pathroot  根路径
+ * @param maglim    极限星等
+ * @param scheme    天区划分方案
+ * @return
+ * 存储结果
+ */
+bool save_cache(const StarTable &table, const char *pathroot, double maglim, int scheme = SKY_GRID);
+/*!
+ * @brief 生成索引文件路径
+ * @param pathroot  根路径
+ * @param maglim    极限星等
+ * @param scheme    天区划分方案
+ * @param nside     HEALPix的Nside
+ * @param fov       视场直径, 量纲: 角度. 0: 完整星表的分区索引
+ * @param nstar     星形的星数. 视场的星表由每像元保留的星数决定, 与星数相关
+ * @param codes     true: 该视场的星形哈希码kd树; false: 该视场的星表
+ * @return
+ * 文件路径: pathroot/tycho2_M<星等>[_H<Nside>[h]][_F<视场>_N<星数>[_codes]].dat. 后缀h表示SKY_HILBERT
+ * @note
+ * - 星表与哈希码kd树的文件名包含决定其内容的全部参数, 以不同参数构建的索引不相互覆盖
  */
-void sort_catalog();
+std::string index_path(const char *pathroot, double maglim, int scheme, int nside, double fov = 0.0, int nstar = 0,
+		bool codes = false);
 
 #endif /* BUILD_INDEX_H_ */
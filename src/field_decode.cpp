@@ -0,0 +1,244 @@
+/**
+ * @file field_decode.cpp Tycho2定宽记录的数值字段解码
+ */
+#include "field_decode.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define FIELD_DECODE_X86
+#include <immintrin.h>
+#endif
+
+const RecordLayout layout_tyc2_mean = {  15,  28, 41, 49, 110, 123, 129 };
+const RecordLayout layout_tyc2_obs  = { 152, 165, 41, 49, 110, 123, 177 };
+const RecordLayout layout_suppl     = {  15,  28, 41, 49,  83,  96, 102 };
+
+typedef int (*RecordDecoder)(const char *line, int len, const RecordLayout &lay, int maglim, CatStar &star);
+
+static int decode_scalar(const char *line, int len, const RecordLayout &lay, int maglim, CatStar &star) {
+	if (len < lay.minlen) return RESOLVE_INVALID;
+	return decode_record_scalar(line, lay, maglim, star);
+}
+
+#ifdef FIELD_DECODE_X86
+/*!
+ * @struct FieldFormat 定点数字段格式
+ */
+struct FieldFormat {
+	int width;	//< 字段宽度
+	int ndec;	//< 小数位数
+	int8_t shuffle[16];	//< 剔除小数点并将数字右对齐的字节重排表
+
+public:
+	FieldFormat(int w, int nd) {
+		int dot = w - nd - 1;
+		int i, j;
+
+		width = w;
+		ndec  = nd;
+		for (i = w - 1, j = 15; i >= 0; --i) {
+			if (i != dot) shuffle[j--] = int8_t(i);
+		}
+		while (j >= 0) shuffle[j--] = int8_t(0x80);
+	}
+};
+
+static const FieldFormat fmt_pos(12, 8);	// 赤经、赤纬
+static const FieldFormat fmt_pm(7, 1);		// 自行
+static const FieldFormat fmt_mag(6, 3);		// 星等
+
+static const double pow10_ndec[] = { 1E0, 1E1, 1E2, 1E3, 1E4, 1E5, 1E6, 1E7, 1E8 };
+
+/*!
+ * @brief 由各类字符的位掩码判定字段状态
+ * @param mdigit  数字
+ * @param mdot    小数点
+ * @param mminus  负号
+ * @param mplus   正号
+ * @param mspace  空格
+ * @param fmt     字段格式
+ * @param negative 是否负数
+ * @return
+ * 1: 数值; 0: 空白; -1: 格式不规整, 须由标量解码
+ * @note
+ * - 规整格式: 前导空格, 可选符号, 连续数字, 小数点位于固定列
+ */
+static inline int classify_field(uint32_t mdigit, uint32_t mdot, uint32_t mminus, uint32_t mplus,
+		uint32_t mspace, const FieldFormat &fmt, bool &negative) {
+	uint32_t win = (1u << fmt.width) - 1;
+	uint32_t msign, mnum, lead;
+	int first;
+
+	mdigit &= win;
+	mdot   &= win;
+	mspace &= win;
+	if (mspace == win) return 0;
+	if (mdot != 1u << (fmt.width - fmt.ndec - 1) || !mdigit) return -1;
+	msign = (mminus | mplus) & win;
+	mnum  = mdigit | mdot;
+	first = __builtin_ctz(mnum);
+	lead  = (1u << first) - 1;
+	if (mnum != (win & ~lead)) return -1;
+	if (msign && (first == 0 || msign != 1u << (first - 1))) return -1;
+	if (mspace != (lead & ~msign)) return -1;
+	negative = (mminus & win) != 0;
+	return 1;
+}
+
+/*!
+ * @brief 组合状态与尾数, 不规整字段退回标量解码
+ */
+static inline bool finish_field(int status, bool negative, int64_t mant, const char *p,
+		const FieldFormat &fmt, double &value) {
+	if (status < 0) return decode_fixed(p, fmt.width, value);
+	if (status == 0) return false;
+	value = double(mant) / pow10_ndec[fmt.ndec];
+	if (negative) value = -value;
+	return true;
+}
+
+__attribute__((target("ssse3")))
+static inline bool decode_field_ssse3(const char *p, const FieldFormat &fmt, double &value) {
+	const __m128i zero = _mm_set1_epi8('0');
+	__m128i v   = _mm_loadu_si128((const __m128i*) p);
+	__m128i d   = _mm_sub_epi8(v, zero);
+	__m128i isd = _mm_and_si128(_mm_cmpgt_epi8(d, _mm_set1_epi8(-1)), _mm_cmplt_epi8(d, _mm_set1_epi8(10)));
+	uint32_t mdigit = _mm_movemask_epi8(isd);
+	uint32_t mdot   = _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('.')));
+	uint32_t mminus = _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('-')));
+	uint32_t mplus  = _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('+')));
+	uint32_t mspace = _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')));
+	bool negative(false);
+	int status = classify_field(mdigit, mdot, mminus, mplus, mspace, fmt, negative);
+	int64_t mant(0);
+
+	if (status > 0) {
+		__m128i t = _mm_shuffle_epi8(_mm_and_si128(d, isd), _mm_loadu_si128((const __m128i*) fmt.shuffle));
+		t = _mm_maddubs_epi16(t, _mm_setr_epi8(10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1));
+		t = _mm_madd_epi16(t, _mm_setr_epi16(100, 1, 100, 1, 100, 1, 100, 1));
+		t = _mm_packs_epi32(t, t);
+		t = _mm_madd_epi16(t, _mm_setr_epi16(10000, 1, 10000, 1, 10000, 1, 10000, 1));
+		mant = int64_t(_mm_cvtsi128_si32(t)) * 100000000 + _mm_cvtsi128_si32(_mm_srli_si128(t, 4));
+	}
+	return finish_field(status, negative, mant, p, fmt, value);
+}
+
+__attribute__((target("ssse3")))
+static int decode_ssse3(const char *line, int len, const RecordLayout &lay, int maglim, CatStar &star) {
+	// 16字节加载不得越过行尾
+	if (len < lay.dc + 16 || len < lay.vt + 16) return decode_scalar(line, len, lay, maglim, star);
+
+	bool has[4];
+	double bt(0.0), vt(0.0);
+	double val[4] = { 0.0, 0.0, 0.0, 0.0 };
+	bool has_bt = decode_field_ssse3(line + lay.bt, fmt_mag, bt);
+	bool has_vt = decode_field_ssse3(line + lay.vt, fmt_mag, vt);
+
+	if (!compose_mag(has_bt, bt, has_vt, vt, star.mag)) return RESOLVE_INVALID;
+	if (star.mag > maglim) return RESOLVE_FAINT;
+	has[0] = decode_field_ssse3(line + lay.ra,   fmt_pos, val[0]);
+	has[1] = decode_field_ssse3(line + lay.dc,   fmt_pos, val[1]);
+	has[2] = decode_field_ssse3(line + lay.pmra, fmt_pm,  val[2]);
+	has[3] = decode_field_ssse3(line + lay.pmdc, fmt_pm,  val[3]);
+	return assign_position(has, val, star);
+}
+
+/*!
+ * @brief 在256位寄存器的两个128位通道中同时解码两个同格式字段
+ */
+__attribute__((target("avx2")))
+static inline void decode_pair_avx2(const char *p1, const char *p2, const FieldFormat &fmt,
+		bool &has1, double &val1, bool &has2, double &val2) {
+	__m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*) p1)),
+			_mm_loadu_si128((const __m128i*) p2), 1);
+	__m256i d   = _mm256_sub_epi8(v, _mm256_set1_epi8('0'));
+	__m256i isd = _mm256_and_si256(_mm256_cmpgt_epi8(d, _mm256_set1_epi8(-1)),
+			_mm256_cmpgt_epi8(_mm256_set1_epi8(10), d));
+	uint32_t mdigit = _mm256_movemask_epi8(isd);
+	uint32_t mdot   = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('.')));
+	uint32_t mminus = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('-')));
+	uint32_t mplus  = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('+')));
+	uint32_t mspace = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')));
+	bool neg1(false), neg2(false);
+	int st1 = classify_field(mdigit, mdot, mminus, mplus, mspace, fmt, neg1);
+	int st2 = classify_field(mdigit >> 16, mdot >> 16, mminus >> 16, mplus >> 16, mspace >> 16, fmt, neg2);
+	int64_t mant1(0), mant2(0);
+
+	if (st1 > 0 || st2 > 0) {
+		__m128i s = _mm_loadu_si128((const __m128i*) fmt.shuffle);
+		__m256i t = _mm256_shuffle_epi8(_mm256_and_si256(d, isd), _mm256_broadcastsi128_si256(s));
+		t = _mm256_maddubs_epi16(t, _mm256_setr_epi8(10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1,
+				10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1));
+		t = _mm256_madd_epi16(t, _mm256_setr_epi16(100, 1, 100, 1, 100, 1, 100, 1,
+				100, 1, 100, 1, 100, 1, 100, 1));
+		t = _mm256_packs_epi32(t, t);
+		t = _mm256_madd_epi16(t, _mm256_setr_epi16(10000, 1, 10000, 1, 10000, 1, 10000, 1,
+				10000, 1, 10000, 1, 10000, 1, 10000, 1));
+		mant1 = int64_t(_mm256_extract_epi32(t, 0)) * 100000000 + _mm256_extract_epi32(t, 1);
+		mant2 = int64_t(_mm256_extract_epi32(t, 4)) * 100000000 + _mm256_extract_epi32(t, 5);
+	}
+	has1 = finish_field(st1, neg1, mant1, p1, fmt, val1);
+	has2 = finish_field(st2, neg2, mant2, p2, fmt, val2);
+}
+
+__attribute__((target("avx2")))
+static int decode_avx2(const char *line, int len, const RecordLayout &lay, int maglim, CatStar &star) {
+	if (len < lay.dc + 16 || len < lay.vt + 16) return decode_scalar(line, len, lay, maglim, star);
+
+	bool has[4], has_bt, has_vt;
+	double bt(0.0), vt(0.0);
+	double val[4] = { 0.0, 0.0, 0.0, 0.0 };
+
+	decode_pair_avx2(line + lay.bt, line + lay.vt, fmt_mag, has_bt, bt, has_vt, vt);
+	if (!compose_mag(has_bt, bt, has_vt, vt, star.mag)) return RESOLVE_INVALID;
+	if (star.mag > maglim) return RESOLVE_FAINT;
+	decode_pair_avx2(line + lay.ra,   line + lay.dc,   fmt_pos, has[0], val[0], has[1], val[1]);
+	decode_pair_avx2(line + lay.pmra, line + lay.pmdc, fmt_pm,  has[2], val[2], has[3], val[3]);
+	return assign_position(has, val, star);
+}
+#endif
+
+/*!
+ * @brief 依据CPU特性选择解码器
+ */
+static RecordDecoder select_decoder(bool simd, const char **name) {
+#ifdef FIELD_DECODE_X86
+	if (simd) {
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2")) {
+			*name = "avx2";
+			return decode_avx2;
+		}
+		if (__builtin_cpu_supports("ssse3")) {
+			*name = "ssse3";
+			return decode_ssse3;
+		}
+	}
+#endif
+	*name = "scalar";
+	return decode_scalar;
+}
+
+static const char *decoder_name_ = "scalar";
+static RecordDecoder decoder_ = select_decoder(true, &decoder_name_);
+
+void enable_simd_decoder(bool enable) {
+	decoder_ = select_decoder(enable, &decoder_name_);
+}
+
+const char *decoder_name() {
+	return decoder_name_;
+}
+
+int decode_records(bool suppl, const char *const lines[], const int lens[], int n, int maglim,
+		CatStar stars[], char status[]) {
+	RecordDecoder decode = decoder_;
+	int i, nok(0);
+
+	for (i = 0; i < n; ++i) {
+		const char *line = lines[i];
+		const RecordLayout &lay = suppl ? layout_suppl :
+				(lens[i] > 13 && line[13] == ' ' ? layout_tyc2_mean : layout_tyc2_obs);
+		if ((status[i] = char(decode(line, lens[i], lay, maglim, stars[i]))) == RESOLVE_OK) ++nok;
+	}
+	return nok;
+}
@@ -0,0 +1,167 @@
+/**
+ * @file field_decode.h Tycho2定宽记录的数值字段解码
+ * @note
+ * - 标量解码器直接由定宽列解析十进制定点数, 不分配内存
+ * - 向量解码器(SSSE3/AVX2)一次处理多个字段, 依据运行时CPU特性选用,
+ *   对格式不规整的字段退回标量解码, 结果与标量解码逐位一致
+ */
+
+#ifndef FIELD_DECODE_H_
+#define FIELD_DECODE_H_
+
+#include <stdint.h>
+#include "ADefine.h"
+#include "build_index.h"
+
+/*!
+ * @struct RecordLayout 记录中数值字段的起始列
+ */
+struct RecordLayout {
+	int ra, dc;		//< 赤经、赤纬, 格式: F12.8
+	int pmra, pmdc;	//< 自行, 格式: F7.1
+	int bt, vt;		//< BT、VT星等, 格式: F6.3
+	int minlen;		//< 记录的最小长度
+};
+
+/*!
+ * @brief tyc2.dat.xx中平位置的列位置
+ */
+extern const RecordLayout layout_tyc2_mean;
+/*!
+ * @brief tyc2.dat.xx中观测位置的列位置. 用于无平位置的记录
+ */
+extern const RecordLayout layout_tyc2_obs;
+/*!
+ * @brief suppl_x.dat的列位置
+ */
+extern const RecordLayout layout_suppl;
+
+/*!
+ * @brief 解析定宽字段中的十进制定点数
+ * @param p      字段首字节
+ * @param width  字段宽度
+ * @param value  数值
+ * @return
+ * 字段是否包含数值. 空白或非法字段返回false
+ * @note
+ * - 整数尾数与10的幂均可被double精确表示, 一次除法即得到正确舍入的结果,
+ *   与stod()的结果逐位一致
+ */
+inline bool decode_fixed(const char *p, int width, double &value) {
+	static const double pow10_tab[] = {
+		1E0, 1E1, 1E2, 1E3, 1E4, 1E5, 1E6, 1E7,
+		1E8, 1E9, 1E10, 1E11, 1E12, 1E13, 1E14, 1E15
+	};
+	const char *end = p + width;
+	int64_t mant(0);
+	int ndigit(0), ndec(-1);
+	bool negative(false);
+
+	while (p < end && *p == ' ') ++p;
+	if (p < end && (*p == '-' || *p == '+')) negative = *p++ == '-';
+	for (; p < end; ++p) {
+		if (*p >= '0' && *p <= '9') {
+			mant = mant * 10 + (*p - '0');
+			++ndigit;
+			if (ndec >= 0) ++ndec;
+		}
+		else if (*p == '.' && ndec < 0) ndec = 0;
+		else break;
+	}
+	while (p < end && *p == ' ') ++p;
+	if (p != end || ndigit == 0 || ndigit > 15) return false;
+
+	value = ndec > 0 ? double(mant) / pow10_tab[ndec] : double(mant);
+	if (negative) value = -value;
+	return true;
+}
+
+/*!
+ * @brief 由BT、VT计算星等
+ * @param has_bt  是否有BT
+ * @param bt      BT星等
+ * @param has_vt  是否有VT
+ * @param vt      VT星等
+ * @param mag     星等, 量纲: 0.001星等
+ * @return
+ * 是否有星等
+ */
+inline bool compose_mag(bool has_bt, double bt, bool has_vt, double vt, short &mag) {
+	if (has_bt && has_vt) mag = short((vt - 0.09 * (bt - vt)) * 1000.0);
+	else if (has_bt || has_vt) mag = short((has_bt ? bt : vt) * 1000.0);
+	else return false;
+	return true;
+}
+
+/*!
+ * @brief 由解码后的位置字段生成星数据. 缺少自行时自行置0
+ * @param has   字段是否有值: 赤经、赤纬、赤经自行、赤纬自行
+ * @param val   字段数值, 顺序同上
+ * @param star  星数据
+ * @return
+ * 解析结果: RESOLVE_OK或RESOLVE_INVALID
+ */
+inline int assign_position(const bool has[4], const double val[4], CatStar &star) {
+	if (!has[0] || !has[1]) return RESOLVE_INVALID;
+
+	star.ra  = int(val[0] * D2MAS);
+	star.spd = int((val[1] + 90.0) * D2MAS);
+	star.pmra = has[2] ? short(val[2]) : 0;
+	star.pmdc = has[3] ? short(val[3]) : 0;
+	return RESOLVE_OK;
+}
+
+/*!
+ * @brief 标量解码一条记录
+ * @param line    一行数据
+ * @param lay     列位置
+ * @param maglim  极限星等, 量纲: 0.001星等
+ * @param star    星数据
+ * @return
+ * 解析结果
+ * @note
+ * - 先解码星等, 暗于极限星等的记录不再解码位置与自行
+ */
+inline int decode_record_scalar(const char *line, const RecordLayout &lay, int maglim, CatStar &star) {
+	bool has[4];
+	double bt(0.0), vt(0.0);
+	double val[4] = { 0.0, 0.0, 0.0, 0.0 };
+	bool has_bt = decode_fixed(line + lay.bt, 6, bt);
+	bool has_vt = decode_fixed(line + lay.vt, 6, vt);
+
+	if (!compose_mag(has_bt, bt, has_vt, vt, star.mag)) return RESOLVE_INVALID;
+	if (star.mag > maglim) return RESOLVE_FAINT;
+	has[0] = decode_fixed(line + lay.ra,   12, val[0]);
+	has[1] = decode_fixed(line + lay.dc,   12, val[1]);
+	has[2] = decode_fixed(line + lay.pmra,  7, val[2]);
+	has[3] = decode_fixed(line + lay.pmdc,  7, val[3]);
+	return assign_position(has, val, star);
+}
+
+/*!
+ * @brief 批量解码记录
+ * @param suppl  true: suppl_x.dat; false: tyc2.dat.xx
+ * @param lines  各行首地址
+ * @param lens   各行长度
+ * @param n      行数
+ * @param maglim 极限星等, 量纲: 0.001星等
+ * @param stars  星数据
+ * @param status 各记录的解析结果
+ * @return
+ * 有效记录数
+ */
+int decode_records(bool suppl, const char *const lines[], const int lens[], int n, int maglim,
+		CatStar stars[], char status[]);
+/*!
+ * @brief 启用或禁用向量解码器
+ * @param enable 是否启用. 启用时依据CPU特性选择AVX2或SSSE3实现
+ */
+void enable_simd_decoder(bool enable);
+/*!
+ * @brief 当前使用的解码器
+ * @return
+ * 解码器名称: avx2, ssse3 或 scalar
+ */
+const char *decoder_name();
+
+#endif /* FIELD_DECODE_H_ */
@@ -0,0 +1,273 @@
+/**
+ * @file sphere_kernel.cpp 基于单位矢量的角距判定
+ */
+#include <math.h>
+#include "ADefine.h"
+#include "sphere_kernel.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SPHERE_KERNEL_X86
+#include <immintrin.h>
+#endif
+
+using namespace std;
+using namespace AstroUtil;
+
+typedef size_t (*SelectKernel)(const double *, const double *, const double *, const int16_t *,
+		uint32_t, uint32_t, const double *, double, int, vector<uint32_t> &);
+typedef void (*DotKernel)(const double *, const double *, const double *, size_t, const double *, double *);
+typedef void (*PropagateKernel)(const double *, const double *, const double *, const int16_t *, const int16_t *,
+		size_t, double, double *, double *, double *);
+
+void unit_vector(double ra, double dec, double v[3]) {
+	double alpha = ra * D2R, delta = dec * D2R;
+	double cd = cos(delta);
+	v[0] = cd * cos(alpha);
+	v[1] = cd * sin(alpha);
+	v[2] = sin(delta);
+}
+
+/*!
+ * @brief 判定一颗星. 各实现的尾部与标量实现共用
+ */
+static inline void select_one(const double *x, const double *y, const double *z, const int16_t *mag,
+		uint32_t i, const double *center, double cosr, int maglim, vector<uint32_t> &result) {
+	if (x[i] * center[0] + y[i] * center[1] + z[i] * center[2] >= cosr && (!mag || mag[i] <= maglim))
+		result.push_back(i);
+}
+
+static size_t select_scalar(const double *x, const double *y, const double *z, const int16_t *mag,
+		uint32_t first, uint32_t n, const double *center, double cosr, int maglim, vector<uint32_t> &result) {
+	size_t n0 = result.size();
+	uint32_t i, end = first + n;
+
+	for (i = first; i < end; ++i) select_one(x, y, z, mag, i, center, cosr, maglim, result);
+	return result.size() - n0;
+}
+
+static void dot_scalar(const double *x, const double *y, const double *z, size_t n, const double *center,
+		double *dot) {
+	for (size_t i = 0; i < n; ++i) dot[i] = x[i] * center[0] + y[i] * center[1] + z[i] * center[2];
+}
+
+static void propagate_scalar(const double *x, const double *y, const double *z, const int16_t *pmra,
+		const int16_t *pmdc, size_t n, double years, double *ox, double *oy, double *oz) {
+	const double k = years * MAS2D * D2R;	// 自行转换为外推弧度
+
+	for (size_t i = 0; i < n; ++i) {
+		double vx(x[i]), vy(y[i]), vz(z[i]);
+		double r = sqrt(vx * vx + vy * vy);
+		double inv = r > 0.0 ? 1.0 / r : 0.0;
+		double a = pmra[i] * k * inv, d = pmdc[i] * k;
+		double dz = d * inv * vz;
+		double px = vx - a * vy - dz * vx;
+		double py = vy + a * vx - dz * vy;
+		double pz = vz + d * r;
+		double s = 1.0 / sqrt(px * px + py * py + pz * pz);
+		ox[i] = px * s;
+		oy[i] = py * s;
+		oz[i] = pz * s;
+	}
+}
+
+#ifdef SPHERE_KERNEL_X86
+/*!
+ * @brief 将判定结果掩码展开为星序号
+ */
+static inline void append_mask(int bits, uint32_t i, vector<uint32_t> &result) {
+	while (bits) {
+		result.push_back(i + uint32_t(__builtin_ctz(bits)));
+		bits &= bits - 1;
+	}
+}
+
+static size_t select_sse2(const double *x, const double *y, const double *z, const int16_t *mag,
+		uint32_t first, uint32_t n, const double *center, double cosr, int maglim, vector<uint32_t> &result) {
+	__m128d cx = _mm_set1_pd(center[0]), cy = _mm_set1_pd(center[1]), cz = _mm_set1_pd(center[2]);
+	__m128d cr = _mm_set1_pd(cosr);
+	size_t n0 = result.size();
+	uint32_t i, end = first + n;
+
+	for (i = first; i + 2 <= end; i += 2) {
+		__m128d d = _mm_add_pd(_mm_add_pd(_mm_mul_pd(_mm_loadu_pd(x + i), cx), _mm_mul_pd(_mm_loadu_pd(y + i), cy)),
+				_mm_mul_pd(_mm_loadu_pd(z + i), cz));
+		int bits = _mm_movemask_pd(_mm_cmpge_pd(d, cr));
+		if (bits && mag) {
+			if (mag[i] > maglim)     bits &= ~1;
+			if (mag[i + 1] > maglim) bits &= ~2;
+		}
+		append_mask(bits, i, result);
+	}
+	if (i < end) select_one(x, y, z, mag, i, center, cosr, maglim, result);
+	return result.size() - n0;
+}
+
+static void dot_sse2(const double *x, const double *y, const double *z, size_t n, const double *center,
+		double *dot) {
+	__m128d cx = _mm_set1_pd(center[0]), cy = _mm_set1_pd(center[1]), cz = _mm_set1_pd(center[2]);
+	size_t i;
+
+	for (i = 0; i + 2 <= n; i += 2) {
+		_mm_storeu_pd(dot + i, _mm_add_pd(_mm_add_pd(_mm_mul_pd(_mm_loadu_pd(x + i), cx),
+				_mm_mul_pd(_mm_loadu_pd(y + i), cy)), _mm_mul_pd(_mm_loadu_pd(z + i), cz)));
+	}
+	if (i < n) dot_scalar(x + i, y + i, z + i, n - i, center, dot + i);
+}
+
+/*!
+ * @note 不使用FMA: 保持与标量实现相同的舍入
+ */
+__attribute__((target("avx2")))
+static inline __m256d dot4_avx2(const double *x, const double *y, const double *z, __m256d cx, __m256d cy,
+		__m256d cz) {
+	return _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(_mm256_loadu_pd(x), cx), _mm256_mul_pd(_mm256_loadu_pd(y), cy)),
+			_mm256_mul_pd(_mm256_loadu_pd(z), cz));
+}
+
+__attribute__((target("avx2")))
+static size_t select_avx2(const double *x, const double *y, const double *z, const int16_t *mag,
+		uint32_t first, uint32_t n, const double *center, double cosr, int maglim, vector<uint32_t> &result) {
+	__m256d cx = _mm256_set1_pd(center[0]), cy = _mm256_set1_pd(center[1]), cz = _mm256_set1_pd(center[2]);
+	__m256d cr = _mm256_set1_pd(cosr);
+	__m256i ml = _mm256_set1_epi32(maglim);
+	size_t n0 = result.size();
+	uint32_t i, end = first + n;
+
+	for (i = first; i + 8 <= end; i += 8) {// 每次8颗星, 大多数星不在区域内
+		__m256d d0 = dot4_avx2(x + i, y + i, z + i, cx, cy, cz);
+		__m256d d1 = dot4_avx2(x + i + 4, y + i + 4, z + i + 4, cx, cy, cz);
+		int bits = _mm256_movemask_pd(_mm256_cmp_pd(d0, cr, _CMP_GE_OQ))
+				| (_mm256_movemask_pd(_mm256_cmp_pd(d1, cr, _CMP_GE_OQ)) << 4);
+		if (!bits) continue;
+		if (mag) {
+			__m256i m = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *) (mag + i)));
+			bits &= ~_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(m, ml)));
+		}
+		append_mask(bits, i, result);
+	}
+	for (; i < end; ++i) select_one(x, y, z, mag, i, center, cosr, maglim, result);
+	return result.size() - n0;
+}
+
+static void propagate_sse2(const double *x, const double *y, const double *z, const int16_t *pmra,
+		const int16_t *pmdc, size_t n, double years, double *ox, double *oy, double *oz) {
+	const double k = years * MAS2D * D2R;
+	__m128d vk = _mm_set1_pd(k), zero = _mm_setzero_pd(), one = _mm_set1_pd(1.0);
+	size_t i;
+
+	for (i = 0; i + 2 <= n; i += 2) {
+		__m128d vx = _mm_loadu_pd(x + i), vy = _mm_loadu_pd(y + i), vz = _mm_loadu_pd(z + i);
+		__m128d r = _mm_sqrt_pd(_mm_add_pd(_mm_mul_pd(vx, vx), _mm_mul_pd(vy, vy)));
+		__m128d inv = _mm_and_pd(_mm_cmpgt_pd(r, zero), _mm_div_pd(one, r));
+		__m128d a = _mm_mul_pd(_mm_mul_pd(_mm_set_pd(pmra[i + 1], pmra[i]), vk), inv);
+		__m128d d = _mm_mul_pd(_mm_set_pd(pmdc[i + 1], pmdc[i]), vk);
+		__m128d dz = _mm_mul_pd(_mm_mul_pd(d, inv), vz);
+		__m128d px = _mm_sub_pd(_mm_sub_pd(vx, _mm_mul_pd(a, vy)), _mm_mul_pd(dz, vx));
+		__m128d py = _mm_sub_pd(_mm_add_pd(vy, _mm_mul_pd(a, vx)), _mm_mul_pd(dz, vy));
+		__m128d pz = _mm_add_pd(vz, _mm_mul_pd(d, r));
+		__m128d s = _mm_div_pd(one, _mm_sqrt_pd(_mm_add_pd(_mm_add_pd(_mm_mul_pd(px, px), _mm_mul_pd(py, py)),
+				_mm_mul_pd(pz, pz))));
+		_mm_storeu_pd(ox + i, _mm_mul_pd(px, s));
+		_mm_storeu_pd(oy + i, _mm_mul_pd(py, s));
+		_mm_storeu_pd(oz + i, _mm_mul_pd(pz, s));
+	}
+	if (i < n) propagate_scalar(x + i, y + i, z + i, pmra + i, pmdc + i, n - i, years, ox + i, oy + i, oz + i);
+}
+
+__attribute__((target("avx2")))
+static void dot_avx2(const double *x, const double *y, const double *z, size_t n, const double *center,
+		double *dot) {
+	__m256d cx = _mm256_set1_pd(center[0]), cy = _mm256_set1_pd(center[1]), cz = _mm256_set1_pd(center[2]);
+	size_t i;
+
+	for (i = 0; i + 4 <= n; i += 4) _mm256_storeu_pd(dot + i, dot4_avx2(x + i, y + i, z + i, cx, cy, cz));
+	if (i < n) dot_scalar(x + i, y + i, z + i, n - i, center, dot + i);
+}
+
+__attribute__((target("avx2")))
+static void propagate_avx2(const double *x, const double *y, const double *z, const int16_t *pmra,
+		const int16_t *pmdc, size_t n, double years, double *ox, double *oy, double *oz) {
+	const double k = years * MAS2D * D2R;
+	__m256d vk = _mm256_set1_pd(k), zero = _mm256_setzero_pd(), one = _mm256_set1_pd(1.0);
+	size_t i;
+
+	for (i = 0; i + 4 <= n; i += 4) {
+		__m256d vx = _mm256_loadu_pd(x + i), vy = _mm256_loadu_pd(y + i), vz = _mm256_loadu_pd(z + i);
+		__m256d ra = _mm256_cvtepi32_pd(_mm_cvtepi16_epi32(_mm_loadl_epi64((const __m128i *) (pmra + i))));
+		__m256d dc = _mm256_cvtepi32_pd(_mm_cvtepi16_epi32(_mm_loadl_epi64((const __m128i *) (pmdc + i))));
+		__m256d r = _mm256_sqrt_pd(_mm256_add_pd(_mm256_mul_pd(vx, vx), _mm256_mul_pd(vy, vy)));
+		__m256d inv = _mm256_and_pd(_mm256_cmp_pd(r, zero, _CMP_GT_OQ), _mm256_div_pd(one, r));
+		__m256d a = _mm256_mul_pd(_mm256_mul_pd(ra, vk), inv);
+		__m256d d = _mm256_mul_pd(dc, vk);
+		__m256d dz = _mm256_mul_pd(_mm256_mul_pd(d, inv), vz);
+		__m256d px = _mm256_sub_pd(_mm256_sub_pd(vx, _mm256_mul_pd(a, vy)), _mm256_mul_pd(dz, vx));
+		__m256d py = _mm256_sub_pd(_mm256_add_pd(vy, _mm256_mul_pd(a, vx)), _mm256_mul_pd(dz, vy));
+		__m256d pz = _mm256_add_pd(vz, _mm256_mul_pd(d, r));
+		__m256d s = _mm256_div_pd(one, _mm256_sqrt_pd(_mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(px, px),
+				_mm256_mul_pd(py, py)), _mm256_mul_pd(pz, pz))));
+		_mm256_storeu_pd(ox + i, _mm256_mul_pd(px, s));
+		_mm256_storeu_pd(oy + i, _mm256_mul_pd(py, s));
+		_mm256_storeu_pd(oz + i, _mm256_mul_pd(pz, s));
+	}
+	if (i < n) propagate_scalar(x + i, y + i, z + i, pmra + i, pmdc + i, n - i, years, ox + i, oy + i, oz + i);
+}
+#endif
+
+static const char *kernel_name_ = "scalar";
+static SelectKernel select_ = select_scalar;
+static DotKernel dot_ = dot_scalar;
+static PropagateKernel propagate_ = propagate_scalar;
+
+/*!
+ * @brief 依据CPU特性选择实现
+ */
+static bool select_kernel(bool simd) {
+	kernel_name_ = "scalar";
+	select_ = select_scalar;
+	dot_    = dot_scalar;
+	propagate_ = propagate_scalar;
+#ifdef SPHERE_KERNEL_X86
+	if (simd) {
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2")) {
+			kernel_name_ = "avx2";
+			select_ = select_avx2;
+			dot_    = dot_avx2;
+			propagate_ = propagate_avx2;
+		}
+		else if (__builtin_cpu_supports("sse2")) {
+			kernel_name_ = "sse2";
+			select_ = select_sse2;
+			dot_    = dot_sse2;
+			propagate_ = propagate_sse2;
+		}
+	}
+#endif
+	return simd;
+}
+
+static bool kernel_inited_ = select_kernel(true);
+
+size_t select_in_cone(const double *x, const double *y, const double *z, const int16_t *mag,
+		uint32_t first, uint32_t n, const double center[3], double cosr, int maglim,
+		vector<uint32_t> &result) {
+	return select_(x, y, z, mag, first, n, center, cosr, maglim, result);
+}
+
+void dot_center(const double *x, const double *y, const double *z, size_t n, const double center[3],
+		double *dot) {
+	dot_(x, y, z, n, center, dot);
+}
+
+void propagate_vectors(const double *x, const double *y, const double *z, const int16_t *pmra,
+		const int16_t *pmdc, size_t n, double years, double *ox, double *oy, double *oz) {
+	propagate_(x, y, z, pmra, pmdc, n, years, ox, oy, oz);
+}
+
+void enable_simd_kernel(bool enable) {
+	kernel_inited_ = select_kernel(enable);
+}
+
+const char *kernel_name() {
+	return kernel_name_;
+}
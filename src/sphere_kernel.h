@@ -0,0 +1,89 @@
+/**
+ * @file sphere_kernel.h 基于单位矢量的角距判定
+ * @note
+ * - 星的单位矢量预先计算(StarTable::UpdateVectors), 角距判定转化为点积与
+ *   cos(半径)的比较, 不调用三角函数
+ * - 向量实现(AVX2/SSE2)一次判定多颗星, 依据运行时CPU特性选用.
+ *   点积的运算顺序与标量实现相同, 结果逐位一致
+ */
+
+#ifndef SPHERE_KERNEL_H_
+#define SPHERE_KERNEL_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+/*!
+ * @brief 由赤道坐标计算单位矢量
+ * @param ra   赤经, 量纲: 角度
+ * @param dec  赤纬, 量纲: 角度
+ * @param v    单位矢量
+ */
+void unit_vector(double ra, double dec, double v[3]);
+/*!
+ * @brief 查找锥形区域内的星
+ * @param x       单位矢量X分量列
+ * @param y       单位矢量Y分量列
+ * @param z       单位矢量Z分量列
+ * @param mag     星等列, 量纲: 毫星等. NULL时不检查星等
+ * @param first   首颗星在各列中的序号
+ * @param n       星数
+ * @param center  锥形中心的单位矢量
+ * @param cosr    锥形半径的余弦
+ * @param maglim  极限星等, 量纲: 毫星等
+ * @param result  检索结果: 星序号, 按升序追加
+ * @return
+ * 检索到的星数
+ * @note
+ * - 判定条件: x*center[0] + y*center[1] + z*center[2] >= cosr 且 mag <= maglim
+ */
+size_t select_in_cone(const double *x, const double *y, const double *z, const int16_t *mag,
+		uint32_t first, uint32_t n, const double center[3], double cosr, int maglim,
+		std::vector<uint32_t> &result);
+/*!
+ * @brief 计算一组星与中心的点积
+ * @param x       单位矢量X分量
+ * @param y       单位矢量Y分量
+ * @param z       单位矢量Z分量
+ * @param n       星数
+ * @param center  中心的单位矢量
+ * @param dot     点积, 即角距的余弦
+ * @note
+ * - 用于构建星形时批量判定星对的角距
+ */
+void dot_center(const double *x, const double *y, const double *z, size_t n, const double center[3],
+		double *dot);
+/*!
+ * @brief 由自行外推单位矢量
+ * @param x      单位矢量X分量
+ * @param y      单位矢量Y分量
+ * @param z      单位矢量Z分量
+ * @param pmra   赤经自行(已乘cos(dec)), 量纲: 毫角秒/年
+ * @param pmdc   赤纬自行, 量纲: 毫角秒/年
+ * @param n      星数
+ * @param years  外推的年数
+ * @param ox     外推后的单位矢量X分量. 可与x相同
+ * @param oy     外推后的单位矢量Y分量. 可与y相同
+ * @param oz     外推后的单位矢量Z分量. 可与z相同
+ * @note
+ * - 沿切平面的赤经、赤纬方向线性外推后归一化. 切向基矢由矢量分量直接构造:
+ *   e_ra = (-y, x, 0) / r, e_dec = (-z * x / r, -z * y / r, r), r = sqrt(x^2 + y^2),
+ *   不调用三角函数. 百年内的外推误差远小于1毫角秒
+ * - 天极处(r = 0)不外推
+ */
+void propagate_vectors(const double *x, const double *y, const double *z, const int16_t *pmra,
+		const int16_t *pmdc, size_t n, double years, double *ox, double *oy, double *oz);
+/*!
+ * @brief 启用或禁用向量实现
+ * @param enable 是否启用. 启用时依据CPU特性选择AVX2或SSE2实现
+ */
+void enable_simd_kernel(bool enable);
+/*!
+ * @brief 当前使用的实现
+ * @return
+ * 实现名称: avx2, sse2 或 scalar
+ */
+const char *kernel_name();
+
+#endif /* SPHERE_KERNEL_H_ */
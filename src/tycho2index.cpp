@@ -13,87 +13,61 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <memory>
 #include "build_index.h"
+#include "StarTable.h"
+#include "HEALPix.h"
+#include "ZoneIndex.h"
+#include "IndexBuilder.h"
+#include "FixedShapeEngine.hpp"
+#include "benchmark.h"
 #include "FITSHandler.hpp"
 #include "ADefine.h"
 using namespace AstroUtil;
 
-///*!
-// * @brief 对tycho2星表排序, 并存储为DAT文件
-// * @param pathroot 根路径
-// * @note
-// * - 星表按照第一优先级赤纬、第二优先级赤经排序. 赤经与赤纬步长=2.5度
-// * - 文件由2部分组成
-// *   1: 索引
-// *   2: 数据
-// */
-//void save_tycho2_data(const char* pathroot) {
-//	// 转换数据格式
-//	int n = stars.size();
-//	int i, ir, id;
-//	int zd = int(180.001 / 2.5);
-//	int zr = int(360.001 / 2.5);
-//	int m  = zd * zr;
-//	double scale = 0.4 * MAS2D;
-//	struct quick_index {
-//		uint32_t head, count;
-//	};
-//	quick_index *index = new quick_index[m];
-//
-//	memset(index, 0, sizeof(quick_index) * m);
-//	for (i = 0; i < n; ++i) {
-//		id = int(stars[i].spd * scale);
-//		ir = int(stars[i].ra * scale);
-//		++index[id * zr + ir].count;
-//	}
-//	for (i = 1; i < m; ++i) index[i].head = index[i-1].head + index[i-1].count;
-//	for (i = 0; i < m; ++i) printf ("%-7d  |  %4d ++ ", index[i].head, index[i].count);
-//	printf ("\n");
-//	// 输出星表
-//	char filepath[100];
-//	sprintf (filepath, "%s/tycho2.dat", pathroot);
-//	FILE *fp = fopen(filepath, "wb");
-//	fwrite(index, sizeof(quick_index), m, fp);
-//	fwrite(stars.data(), sizeof(CatStar), n, fp);
-//	fclose(fp);
-//	// 释放资源
-//	delete []index;
-//}
-//
-///*!
-// * @brief 由Tycho2原始星表生成用于星图匹配的索引文件
-// * @param argc 命令行参量数量
-// * @param argv 命令行参数
-// * @return
-// * 处理结果
-// * @note
-// * 命令行参数:
-// * - 视场
-// * - 最暗星等
-// */
-//int main(int argc, char **argv) {
-//	load_catalog(".");
-//	printf ("load_catalog() over\n");
-//	sort_catalog();
-//	printf ("sort_catalog() over\n");
-//	save_tycho2_data(".");
-//	printf ("save_tycho2() over\n");
-//	return 0;
-//}
-
 void Usage() {
 	printf( "Usage:\n"
 			"\t tycho2index [options] \n"
 			"\nOptions:\n"
 			" -h / --help   : print this help message\n"
-			" -F / --fov    : the diameter of field of view, in degrees\n"
+			" -F / --fov    : the diameter of field of view, in degrees.\n"
+			"                 a comma separated list builds one index per FOV, e.g. 0.5,1,2,4,8\n"
 			" -M / --mag    : the faintest magnitude\n"
-			" -N / --num    : the least star number in one shape excluding both center and orient\n"
+			" -N / --num    : the number of stars in one shape, 3 to 10. default: 4, i.e. quads\n"
+			"                 3 builds a triangle index of side ratios and parity\n"
 			" -S / --style  : the style of output file. 1: BINARY; 2: FITS\n"
+			" -P / --path   : the directory of Tycho-2 catalog files\n"
+			" -H / --healpix: partition the sky into HEALPix cells of given Nside, a power of 2.\n"
+			"                 default: 2.5 x 2.5 degrees RA/Dec zones\n"
+			" -O / --order  : the order of stars in memory and files, used with -H.\n"
+			"                 morton: NESTED pixel order (default); hilbert: Hilbert curve in each base face\n"
+			" -E / --epoch  : the epoch of observation, e.g. 2024.5. default: 2000.0\n"
+			"                 stars are propagated by proper motion when searched\n"
+			" -Q / --quantize: store shape hash codes as 16-bit fixed point numbers\n"
+			" -B / --bench  : run a benchmark and exit. parse, epoch, sort, cone, kdtree, cache, pm,\n"
+			"                 triangle, shape, codetree, quantize\n"
 			"\n"
 			);
 }
 
+/**
+ * @brief 按星形的星数选择编译期特化的星形生成器
+ * @return
+ * 星形生成器. 3颗星时使用三角形索引, 返回NULL
+ */
+ShapeEngine *new_shape_engine(int nstar) {
+	switch (nstar) {
+	case 4:  return new FixedShapeEngine<4>;
+	case 5:  return new FixedShapeEngine<5>;
+	case 6:  return new FixedShapeEngine<6>;
+	case 7:  return new FixedShapeEngine<7>;
+	case 8:  return new FixedShapeEngine<8>;
+	case 9:  return new FixedShapeEngine<9>;
+	case 10: return new FixedShapeEngine<10>;
+	default: return NULL;
+	}
+}
+
 /**
  * @brief
  * 由tycho2星表生成星表索引
@@ -105,27 +79,57 @@ int main(int argc, char** argv) {
 		{ "mag",     required_argument, NULL, 'M' },
 		{ "num",     required_argument, NULL, 'N' },
 		{ "style",   required_argument, NULL, 'S' },
+		{ "path",    required_argument, NULL, 'P' },
+		{ "healpix", required_argument, NULL, 'H' },
+		{ "order",   required_argument, NULL, 'O' },
+		{ "epoch",   required_argument, NULL, 'E' },
+		{ "quantize", no_argument,      NULL, 'Q' },
+		{ "bench",   required_argument, NULL, 'B' },
 		{ NULL,      0,           NULL,  0  }
 	};
-	char optstr[] = "hF:M:N:S:";
+	char optstr[] = "hF:M:N:S:P:H:O:E:QB:";
 	int ch, optndx;
-	double fov(1.0), faint(10.0);
-	int kstar(3), style(2);
+	double faint(10.0), epoch(CATALOG_EPOCH);
+	std::vector<double> fovs;
+	int nstar(4), style(2), nside(0);
+	bool quantize(false);
+	const char *pathroot = ".";
+	const char *bench = NULL;
+	const char *order = "morton";
 
 	while ((ch = getopt_long(argc, argv, optstr, longopts, NULL)) != -1) {
 		switch (ch) {
 		case 'F':
-			fov = atof(optarg);
+			fovs.clear();
+			for (char *p = strtok(optarg, ","); p; p = strtok(NULL, ",")) fovs.push_back(atof(p));
 			break;
 		case 'M':
 			faint = atof(optarg);
 			break;
 		case 'N':
-			kstar = atoi(optarg);
+			nstar = atoi(optarg);
 			break;
 		case 'S':
 			style = atoi(optarg);
 			break;
+		case 'P':
+			pathroot = optarg;
+			break;
+		case 'H':
+			nside = atoi(optarg);
+			break;
+		case 'O':
+			order = optarg;
+			break;
+		case 'E':
+			epoch = atof(optarg);
+			break;
+		case 'Q':
+			quantize = true;
+			break;
+		case 'B':
+			bench = optarg;
+			break;
 		default:
 			Usage();
 			return 1;
@@ -134,15 +138,35 @@ int main(int argc, char** argv) {
 	argc -= optind;
 	argv += optind;
 
-	if (fov < 0.1 || fov > 60.0) {
-		printf ("the diameter of FOV should be between 0.1 and 60 degrees\n");
-		return -1;
+	if (bench) {
+		if (!strcmp(bench, "parse")) return bench_parser(pathroot);
+		if (!strcmp(bench, "epoch")) return bench_epoch(1000000);
+		if (!strcmp(bench, "sort"))  return bench_sort(pathroot);
+		if (!strcmp(bench, "cone"))  return bench_cone(pathroot, nside ? nside : 64);
+		if (!strcmp(bench, "kdtree")) return bench_kdtree(pathroot);
+		if (!strcmp(bench, "cache")) return bench_cache(pathroot);
+		if (!strcmp(bench, "shape")) return bench_shape(pathroot, fovs.size() ? fovs[0] : 2.0, faint);
+		if (!strcmp(bench, "triangle")) return bench_triangle(pathroot, fovs.size() ? fovs[0] : 2.0, faint);
+		if (!strcmp(bench, "codetree")) return bench_codetree(pathroot, fovs.size() ? fovs[0] : 2.0, faint);
+		if (!strcmp(bench, "quantize")) return bench_quantize(pathroot, fovs.size() ? fovs[0] : 2.0, faint);
+		if (!strcmp(bench, "pm"))    return bench_propagate(pathroot, nside ? nside : 64,
+				epoch != CATALOG_EPOCH ? epoch : 2025.0);
+		printf ("unknown benchmark: %s\n", bench);
+		return -5;
+	}
+
+	if (fovs.empty()) fovs.push_back(1.0);
+	for (size_t i = 0; i < fovs.size(); ++i) {
+		if (fovs[i] < 0.1 || fovs[i] > 60.0) {
+			printf ("the diameter of FOV should be between 0.1 and 60 degrees\n");
+			return -1;
+		}
 	}
 	if (faint < 5.0 || faint > 12.0) {
 		printf ("the faintest magnitude should be between 5.0 and 12.0\n");
 		return -2;
 	}
-	if (kstar < 3 || kstar > 10) {
+	if (nstar < 3 || nstar > SHAPE_MAX_STAR) {
 		printf ("the star number in any shape should be between 3 and 10\n");
 		return -3;
 	}
@@ -150,6 +174,56 @@ int main(int argc, char** argv) {
 		printf ("style value should be 1 or 2\n");
 		return -4;
 	}
+	if (epoch < 1900.0 || epoch > 2100.0) {
+		printf ("the epoch should be between 1900 and 2100\n");
+		return -10;
+	}
+	if (nside && (!HEALPix::ValidNside(nside) || nside > 1024)) {
+		printf ("Nside of HEALPix should be a power of 2 not greater than 1024\n");
+		return -6;
+	}
+
+	StarTable table;
+	if (strcmp(order, "morton") && strcmp(order, "hilbert")) {
+		printf ("order should be morton or hilbert\n");
+		return -9;
+	}
+	if (!nside && !strcmp(order, "hilbert")) {
+		printf ("order hilbert requires HEALPix partition, specified by -H\n");
+		return -9;
+	}
+
+	int scheme = !nside ? SKY_GRID : (strcmp(order, "hilbert") ? SKY_HEALPIX : SKY_HILBERT);
+	if (!load_cache(table, pathroot, faint, scheme)) {
+		load_catalog(table, pathroot, faint);
+		sort_catalog(table, 0, SORT_RADIX, scheme);
+		save_cache(table, pathroot, faint, scheme);
+	}
+	if (healpix_scheme(scheme)) {
+		HEALPix hp(nside);
+		std::vector<uint32_t> head;
+		uint32_t nmax(0);
+		int64_t p, nused(0);
+
+		pixel_ranges(table, hp, head);
+		for (p = 0; p < hp.Npix(); ++p) {
+			uint32_t n = head[p + 1] - head[p];
+			if (n) ++nused;
+			if (n > nmax) nmax = n;
+		}
+		printf ("%ld HEALPix cells of %.3f degrees, %ld occupied, %.1f stars per cell in average, %u at most\n",
+				long(hp.Npix()), hp.PixelSize() * R2D, long(nused), double(table.Size()) / hp.Npix(), nmax);
+	}
+
+	std::string filepath = index_path(pathroot, faint, scheme, nside);
+	if (!ZoneIndex::Save(filepath.c_str(), table, scheme, nside, epoch)) return -7;
+	printf ("zone index saved to %s\n", filepath.c_str());
+
+	// 各视场的索引共用星表
+	IndexBuilder builder(table, faint, nstar, scheme, nside, epoch, quantize);
+	for (size_t i = 0; i < fovs.size(); ++i) builder.AddScale(fovs[i]);
+	std::unique_ptr<ShapeEngine> engine(new_shape_engine(nstar));
+	if (!builder.Build(pathroot, engine.get())) return -8;
 
 	return 0;
 }
@@ -0,0 +1,83 @@
+/**
+ * @file uniformize.cpp 星的均匀化选择
+ */
+#include <math.h>
+#include <algorithm>
+#include "ADefine.h"
+#include "HEALPix.h"
+#include "RunThreads.hpp"
+#include "uniformize.h"
+
+using namespace std;
+using namespace AstroUtil;
+
+#define UNIFORM_MAX_NSIDE	1024	//< 均匀化像元Nside的上限: 像元尺寸3.4角分, 像元数1258万
+
+int uniform_nside(double fov) {
+	HEALPix hp;
+	int nside;
+
+	for (nside = 1; nside < UNIFORM_MAX_NSIDE; nside *= 2) {
+		hp.SetNside(nside);
+		if (hp.PixelSize() * R2D <= fov * 0.25) break;
+	}
+	return nside;
+}
+
+int uniform_quota(double fov, int nstar, int nside) {
+	HEALPix hp(nside);
+	double size = hp.PixelSize() * R2D;
+	double ncell = API * fov * fov * 0.25 / (size * size);	// 视场内的像元数
+	int k = int(ceil(5.0 * nstar / ncell));
+	return k < 1 ? 1 : k;
+}
+
+size_t uniformize(const StarTable &table, int nside, int k, StarTable::IndexVec &keep, int nthread) {
+	HEALPix hp(nside);
+	size_t i, n = table.Size();
+	int64_t p, npix = hp.Npix();
+	vector<uint32_t> pix(n), head(npix + 1, 0), order(n);
+	vector<char> flag(n, 0);
+
+	keep.clear();
+	if (!n || k <= 0) return 0;
+	if (nthread <= 0) nthread = thread::hardware_concurrency();
+	if (nthread < 1) nthread = 1;
+
+	// 各星的像元
+	run_threads(nthread, [&table, &hp, &pix, n, nthread](int t) {
+		size_t i0 = n * t / nthread, i1 = n * (t + 1) / nthread;
+		for (size_t j = i0; j < i1; ++j) pix[j] = uint32_t(hp.Vec2Pix(table.x[j], table.y[j], table.z[j]));
+	});
+	// 按像元计数排序. 同一像元的星保持序号升序
+	for (i = 0; i < n; ++i) ++head[pix[i] + 1];
+	for (p = 0; p < npix; ++p) head[p + 1] += head[p];
+	{
+		vector<uint32_t> pos(head.begin(), head.end() - 1);
+		for (i = 0; i < n; ++i) order[pos[pix[i]]++] = uint32_t(i);
+	}
+
+	// 各线程处理星数相近的一段像元, 每个像元保留星等最小的k颗星
+	run_threads(nthread, [&table, &head, &order, &flag, npix, n, k, nthread](int t) {
+		int64_t p0 = lower_bound(head.begin(), head.end() - 1, uint32_t(n * t / nthread)) - head.begin();
+		int64_t p1 = lower_bound(head.begin(), head.end() - 1, uint32_t(n * (t + 1) / nthread)) - head.begin();
+		if (t == nthread - 1) p1 = npix;
+		auto brighter = [&table](uint32_t a, uint32_t b) {
+			return table.mag[a] < table.mag[b] || (table.mag[a] == table.mag[b] && a < b);
+		};
+
+		for (int64_t q = p0; q < p1; ++q) {
+			uint32_t *first = &order[0] + head[q], *last = &order[0] + head[q + 1];
+			if (last - first > k) {
+				nth_element(first, first + k - 1, last, brighter);
+				last = first + k;
+			}
+			for (; first < last; ++first) flag[*first] = 1;
+		}
+	});
+
+	for (i = 0; i < n; ++i) {
+		if (flag[i]) keep.push_back(uint32_t(i));
+	}
+	return keep.size();
+}
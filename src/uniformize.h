@@ -0,0 +1,48 @@
+/**
+ * @file uniformize.h 星的均匀化选择
+ * @note
+ * - 将天球划分为细分HEALPix像元, 每个像元只保留最亮的K颗星, 使参与构建星形的
+ *   星在全天均匀分布. 索引规模与构建时间取决于天区面积, 而非星密度
+ * - 像元尺寸与K由视场直径和星形的星数确定
+ */
+
+#ifndef UNIFORMIZE_H_
+#define UNIFORMIZE_H_
+
+#include "StarTable.h"
+
+/*!
+ * @brief 由视场直径确定均匀化像元的Nside
+ * @param fov  视场直径, 量纲: 角度
+ * @return
+ * 像元尺寸不大于视场直径1/4的最小Nside
+ */
+int uniform_nside(double fov);
+/*!
+ * @brief 计算每个像元保留的星数
+ * @param fov    视场直径, 量纲: 角度
+ * @param nstar  每个星形的星数(-N)
+ * @param nside  均匀化像元的Nside
+ * @return
+ * 每个像元保留的星数K
+ * @note
+ * - 每个视场内期望保留5*nstar颗星, 按视场内的像元数平均分配
+ */
+int uniform_quota(double fov, int nstar, int nside);
+/*!
+ * @brief 均匀化选择
+ * @param table    星表. 单位矢量已计算
+ * @param nside    均匀化像元的Nside
+ * @param k        每个像元保留的星数
+ * @param keep     保留的星序号, 升序排列
+ * @param nthread  线程数. 0: 使用全部硬件线程
+ * @return
+ * 保留的星数
+ * @note
+ * - 各线程计算一段星的像元, 再以计数排序按像元分组, 之后各线程独立处理一段像元
+ * - 同一像元内按星等、星序号选择, 结果与线程数无关
+ * - 保留的星序号升序排列, 由StarTable::Gather()取出的星表保持原排序
+ */
+size_t uniformize(const StarTable &table, int nside, int k, StarTable::IndexVec &keep, int nthread = 0);
+
+#endif /* UNIFORMIZE_H_ */